@@ -2,3 +2,86 @@
 
 
 #include "MirrorAnimInstance.h"
+
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+
+void FMirrorAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	const USkeletalMeshComponent* Source = CastChecked<UMirrorAnimInstance>(InAnimInstance)->GetSourceMesh();
+	const USkeletalMeshComponent* Target = GetSkelMeshComponent();
+	const USkeletalMesh* NewSourceAsset = Source ? Source->GetSkeletalMeshAsset() : nullptr;
+	const USkeletalMesh* NewTargetAsset = Target ? Target->GetSkeletalMeshAsset() : nullptr;
+	if (!NewSourceAsset || !NewTargetAsset)
+	{
+		SourceComponentTransforms.Reset();
+		return;
+	}
+
+	if (SourceAsset.Get() != NewSourceAsset || TargetAsset.Get() != NewTargetAsset)
+	{
+		SourceAsset = NewSourceAsset;
+		TargetAsset = NewTargetAsset;
+
+		const FReferenceSkeleton& SourceSkeleton = NewSourceAsset->GetRefSkeleton();
+		const FReferenceSkeleton& TargetSkeleton = NewTargetAsset->GetRefSkeleton();
+		SourceParentIndices.SetNumUninitialized(SourceSkeleton.GetNum());
+		for (int32 BoneIndex = 0; BoneIndex < SourceSkeleton.GetNum(); ++BoneIndex)
+		{
+			SourceParentIndices[BoneIndex] = SourceSkeleton.GetParentIndex(BoneIndex);
+		}
+
+		SourceBoneIndices.SetNumUninitialized(TargetSkeleton.GetNum());
+		for (int32 BoneIndex = 0; BoneIndex < TargetSkeleton.GetNum(); ++BoneIndex)
+		{
+			SourceBoneIndices[BoneIndex] = NewSourceAsset == NewTargetAsset
+				? BoneIndex : SourceSkeleton.FindBoneIndex(TargetSkeleton.GetBoneName(BoneIndex));
+		}
+	}
+
+	// Read buffer of the source, which has ticked already (see APortalMirrorProxy::SetSourceMesh)
+	SourceComponentTransforms = Source->GetComponentSpaceTransforms();
+}
+
+void FMirrorAnimInstanceProxy::UpdateAnimationNode(const FAnimationUpdateContext& InContext)
+{
+	// The pose comes from the source mesh, there is no graph to update
+}
+
+bool FMirrorAnimInstanceProxy::Evaluate(FPoseContext& Output)
+{
+	Output.ResetToRefPose();
+	if (SourceComponentTransforms.Num() != SourceParentIndices.Num())
+	{
+		return true;
+	}
+
+	const FBoneContainer& BoneContainer = Output.Pose.GetBoneContainer();
+	for (const FCompactPoseBoneIndex BoneIndex : Output.Pose.ForEachBoneIndex())
+	{
+		const int32 MeshBoneIndex = BoneContainer.MakeMeshPoseIndex(BoneIndex).GetInt();
+		const int32 SourceIndex = SourceBoneIndices.IsValidIndex(MeshBoneIndex) ? SourceBoneIndices[MeshBoneIndex] : INDEX_NONE;
+		if (SourceIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const int32 SourceParentIndex = SourceParentIndices[SourceIndex];
+		Output.Pose[BoneIndex] = SourceParentIndex == INDEX_NONE
+			? SourceComponentTransforms[SourceIndex]
+			: SourceComponentTransforms[SourceIndex].GetRelativeTransform(SourceComponentTransforms[SourceParentIndex]);
+	}
+	return true;
+}
+
+FAnimInstanceProxy* UMirrorAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FMirrorAnimInstanceProxy(this);
+}
+
+void UMirrorAnimInstance::DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy)
+{
+	delete static_cast<FMirrorAnimInstanceProxy*>(InProxy);
+}
@@ -4,8 +4,44 @@
 
 #include "CoreMinimal.h"
 #include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
 #include "MirrorAnimInstance.generated.h"
 
+/**
+ * Copies the already evaluated pose of the source mesh instead of running an anim graph.
+ * The source transforms are grabbed on the game thread, the local pose is built on the animation worker threads.
+ */
+USTRUCT()
+struct PORTAL_API FMirrorAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FMirrorAnimInstanceProxy() = default;
+
+	FMirrorAnimInstanceProxy(UAnimInstance* InAnimInstance)
+		: FAnimInstanceProxy(InAnimInstance)
+	{
+	}
+
+protected:
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void UpdateAnimationNode(const FAnimationUpdateContext& InContext) override;
+	virtual bool Evaluate(FPoseContext& Output) override;
+
+private:
+	/** Component space pose of the source mesh from its last evaluation */
+	TArray<FTransform> SourceComponentTransforms;
+
+	/** Parent of every source bone */
+	TArray<int32> SourceParentIndices;
+
+	/** Mesh bone index of this instance -> source mesh bone index */
+	TArray<int32> SourceBoneIndices;
+
+	TWeakObjectPtr<const USkeletalMesh> SourceAsset{nullptr};
+	TWeakObjectPtr<const USkeletalMesh> TargetAsset{nullptr};
+};
+
 /**
  * 
  */
@@ -21,4 +57,9 @@ public:
 
 	UPROPERTY(BlueprintReadWrite)
 	TWeakObjectPtr<USkeletalMeshComponent> SourceMesh;
+
+protected:
+
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+	virtual void DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy) override;
 };
@@ -21,7 +21,7 @@ public class Portal : ModuleRules
 			"GameplayTags",
 		});
 
-		PrivateDependencyModuleNames.AddRange(new string[] { });
+		PrivateDependencyModuleNames.AddRange(new string[] { "TraceLog" });
 
 		PublicIncludePaths.AddRange(new string[] {
 			"Portal",
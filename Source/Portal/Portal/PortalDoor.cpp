@@ -3,18 +3,135 @@
 
 #include "PortalDoor.h"
 
-#include "MirrorAnimInstance.h"
 #include "PortalCharacter.h"
+#include "ConvexVolume.h"
+#include "SceneView.h"
 #include "Camera/CameraComponent.h"
 #include "Components/BoxComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/LocalPlayer.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "GameFramework/Character.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
 #include "Kismet/GameplayStatics.h"
+#include "Math/InverseRotationMatrix.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "PortalMirrorPool.h"
+#include "PortalMirrorProxy.h"
+#include "PortalRenderTargetPool.h"
+#include "PortalSpringArmComponent.h"
+#include "PortalSubsystem.h"
+#include "PortalTraversalSubsystem.h"
 #include "StateMachine/StateMachineComponent.h"
 
 #include "Global/PGameplayTags.h"
+#include "Global/PortalStats.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Captures"), STAT_PortalCaptures, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped Captures"), STAT_PortalSkippedCaptures, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Recursive Captures"), STAT_PortalRecursiveCaptures, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Unchanged Captures"), STAT_PortalUnchangedCaptures, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Throttled Captures"), STAT_PortalThrottledCaptures, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Snapshot Captures"), STAT_PortalSnapshotCaptures, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resolution Changes"), STAT_PortalResolutionChanges, STATGROUP_Portal);
+
+static TAutoConsoleVariable<int32> CVarPortalAdaptiveResolution(
+	TEXT("r.Portal.AdaptiveResolution"),
+	1,
+	TEXT("0: portal render targets always match the game viewport.\n")
+	TEXT("1: portal render targets follow the on-screen size of the portal plane, a plane covering a quarter of the view\n")
+	TEXT("   gets a target of half the viewport size."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalAdaptiveResolutionLevels(
+	TEXT("r.Portal.AdaptiveResolution.Levels"),
+	3,
+	TEXT("Render target sizes adaptive portals pick from, each half the size of the previous one, starting at the viewport.\n")
+	TEXT("A door keeps the levels it used until it goes idle, so switching between them never allocates."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarPortalAdaptiveResolutionHysteresis(
+	TEXT("r.Portal.AdaptiveResolution.Hysteresis"),
+	0.25f,
+	TEXT("Margin below a smaller level the portal plane's footprint needs before its target actually shrinks."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalSkipHiddenCaptures(
+	TEXT("r.Portal.SkipHiddenCaptures"),
+	1,
+	TEXT("Skip a portal capture when the plane showing it is outside the player view or was occluded last frame."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalRecursionMaxDepth(
+	TEXT("r.Portal.Recursion.MaxDepth"),
+	2,
+	TEXT("Extra captures a portal renders for its link plane seen through itself. 0 disables recursion."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarPortalRecursionResolutionScale(
+	TEXT("r.Portal.Recursion.ResolutionScale"),
+	0.5f,
+	TEXT("Render target scale applied at every recursion level."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalRecursionPixelBudget(
+	TEXT("r.Portal.Recursion.PixelBudget"),
+	1024 * 1024,
+	TEXT("Pixels all portals together may render in recursive captures per frame. Capture GPU cost follows the\n")
+	TEXT("pixel count, unlike the game thread time of queueing it. Levels over budget keep showing the previous frame's texture."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalDirtyTracking(
+	TEXT("r.Portal.DirtyTracking"),
+	0,
+	TEXT("Skip a portal capture when neither the capture view nor any registered mover in it changed since the last one.\n")
+	TEXT("Movers are portal traversers, mirror proxies and actors passed to UPortalSubsystem::RegisterCaptureMover.\n")
+	TEXT("Anything else that changes, such as AI, physics, particles or lights, shows up to r.Portal.MaxStaleFrames late,\n")
+	TEXT("so only enable it for levels where every moving actor is registered."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalMaxStaleFrames(
+	TEXT("r.Portal.MaxStaleFrames"),
+	30,
+	TEXT("A portal is captured at least this often, to pick up changes dirty tracking can't see such as lighting."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalThrottleInterval(
+	TEXT("r.Portal.Throttle.Interval"),
+	1,
+	TEXT("Far portals, and portals whose view is static, are captured every this many frames. 1 disables throttling.\n")
+	TEXT("Skipped frames show the last capture as is, so far portals lag behind camera motion."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarPortalThrottleDistance(
+	TEXT("r.Portal.Throttle.Distance"),
+	3000.0f,
+	TEXT("Distance from the player camera beyond which a portal counts as far for r.Portal.Throttle.Interval."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarPortalCaptureLODHysteresis(
+	TEXT("r.Portal.CaptureLOD.Hysteresis"),
+	0.1f,
+	TEXT("Fraction the current capture tier's MaxDistance is widened and MinCoverage narrowed by before the door drops to a lower tier."),
+	ECVF_Scalability);
+
+/** Features dropped from the captures of deeper recursion levels, which only cover a few pixels. */
+static void ReduceRecursionShowFlags(FEngineShowFlags& ShowFlags, const int32 Level)
+{
+	ShowFlags.SetAmbientOcclusion(false);
+	ShowFlags.SetScreenSpaceReflections(false);
+	ShowFlags.SetContactShadows(false);
+	ShowFlags.SetMotionBlur(false);
+	ShowFlags.SetBloom(false);
+	if (Level > 2)
+	{
+		ShowFlags.SetDynamicShadows(false);
+		ShowFlags.SetVolumetricFog(false);
+	}
+}
 
 APortalDoor::APortalDoor()
 {
@@ -29,175 +146,1192 @@ APortalDoor::APortalDoor()
 
 	PortalCamera = CreateDefaultSubobject<USceneCaptureComponent2D>("PortalCamera");
 	PortalCamera->SetupAttachment(RootComponent);
+	// Captured explicitly from UpdatePortalCapture
+	PortalCamera->bCaptureEveryFrame = false;
+	PortalCamera->bCaptureOnMovement = false;
+
+	ViewCamera = CreateDefaultSubobject<UCameraComponent>("PlayerCamera");
+	ViewCamera->SetupAttachment(RootComponent);
+
+	CrossingDetectionBox = CreateDefaultSubobject<UBoxComponent>("CrossingDetectionBox");
+	CrossingDetectionBox->SetupAttachment(RootComponent);
+
+	ActivateDetectionBox = CreateDefaultSubobject<UBoxComponent>("ActivateDetectionBox");
+	ActivateDetectionBox->SetupAttachment(RootComponent);
+
+	StateMachine = CreateDefaultSubobject<UStateMachineComponent>("StateMachineComponent");
+	// Portal states keep nothing per door, one set serves every door
+	StateMachine->bShareStates = true;
+
+	MirrorProxyClass = APortalMirrorProxy::StaticClass();
+}
+
+void APortalDoor::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+	Tags.Add(PortalTag);
+
+	if (UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld()))
+	{
+		PortalSubsystem->RegisterPortal(this);
+	}
+}
+
+void APortalDoor::BeginPlay()
+{
+	Super::BeginPlay();
+	
+	if (GEngine && GEngine->GameViewport)
+	{
+		FViewport* Viewport = GEngine->GameViewport->Viewport;
+		Viewport->ViewportResizedEvent.AddUObject(this, &APortalDoor::OnViewportResized);
+	}
+	
+	InitTextureTarget();
+	PrewarmRenderTargets();
+
+	// Every level has to be reachable by coverage alone, otherwise adaptive resolution never shrinks
+	for (int32 Level = 0; Level < GetNumRenderTargetLevels(); ++Level)
+	{
+		const float Coverage = 0.9f * FMath::Pow(0.25f, Level);
+		ensureMsgf(GetRenderTargetLevelForFraction(GetRenderTargetFractionForCoverage(Coverage)) == Level,
+			TEXT("Portal coverage %f doesn't select render target level %d"), Coverage, Level);
+	}
+
+	// The state machine entered UnActive in Super::BeginPlay, before the Plane material existed
+	if (!bRenderTargetActive)
+	{
+		SetSnapshotActive(GetIdleMode() == EPortalIdleMode::Snapshot);
+	}
+
+	RootComponent->TransformUpdated.AddUObject(this, &APortalDoor::OnRootTransformUpdated);
+
+	// Traversers only cross doors of the portal registry
+	UPortalTraversalSubsystem* TraversalSubsystem = GetWorld()->GetSubsystem<UPortalTraversalSubsystem>();
+	const UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+	if (TraversalSubsystem && PortalSubsystem && PortalSubsystem->FindPortal(PortalTag) == this)
+	{
+		TraversalSubsystem->RegisterDoor(this);
+	}
+
+	// The boxes only describe the zones tested by UPortalTraversalSubsystem, keep them out of the physics scene
+	if (TraversalSubsystem && TraversalSubsystem->IsSweptCrossingEnabled())
+	{
+		ActivateDetectionBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		CrossingDetectionBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		return;
+	}
+	
+	ActivateDetectionBox->OnComponentBeginOverlap.AddDynamic(this, &APortalDoor::OnActivateBoxOverlapBegin);
+	ActivateDetectionBox->OnComponentEndOverlap.AddDynamic(this, &APortalDoor::OnActivateBoxOverlapEnd);
+	CrossingDetectionBox->OnComponentBeginOverlap.AddDynamic(this, &APortalDoor::OnCrossBoxOverlapBegin);
+	CrossingDetectionBox->OnComponentEndOverlap.AddDynamic(this, &APortalDoor::OnCrossBoxOverlapEnd);
+}
+
+void APortalDoor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Release while still linked so the link's PortalCamera stops drawing into it
+	SetRenderTargetLevel(INDEX_NONE);
+	ReleaseRecursionTargets();
+	ReleaseMirrorProxy();
+	SetViewUpdate(EPortalViewUpdate::None);
+	GetWorldTimerManager().ClearTimer(SnapshotTimer);
+	ReleaseSnapshotTargets();
+
+	if (UPortalTraversalSubsystem* TraversalSubsystem = GetWorld()->GetSubsystem<UPortalTraversalSubsystem>())
+	{
+		TraversalSubsystem->UnregisterDoor(this);
+	}
+
+	if (UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld()))
+	{
+		PortalSubsystem->UnregisterPortal(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APortalDoor::OnLinkPortalChanged(APortalDoor* NewLinkPortal)
+{
+	// Losing the link while active, fall back to idle
+	const UStateBase* CurrentState = StateMachine->GetCurrentState();
+	if (!NewLinkPortal && HasActorBegunPlay() && !GetWorld()->bIsTearingDown
+		&& CurrentState && CurrentState->GetStateTag() != GameplayTags::Portal::UnActive)
+	{
+		StateMachine->TryChangeState(GameplayTags::Portal::UnActive);
+	}
+
+	// The old link's PortalCamera must stop drawing into RTPortal
+	APortalDoor* OldLinkPortal = GetLinkPortal();
+	if (OldLinkPortal && OldLinkPortal != NewLinkPortal && OldLinkPortal->PortalCamera->TextureTarget == RTPortal)
+	{
+		OldLinkPortal->PortalCamera->TextureTarget = nullptr;
+		OldLinkPortal->ReleaseRecursionTargets();
+	}
+
+	LinkPortal = NewLinkPortal;
+	bThroughTransformValid = false;
+	InvalidateSnapshots();
+
+	// Relinked while active, the new link's PortalCamera takes over the current target
+	if (NewLinkPortal && NewLinkPortal != OldLinkPortal && bRenderTargetActive && RTPortal)
+	{
+		NewLinkPortal->PortalCamera->TextureTarget = RTPortal;
+		ApplyCaptureSettings(NewLinkPortal->PortalCamera);
+	}
+}
+
+void APortalDoor::OnRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	// Both directions of the pair depend on this door
+	bThroughTransformValid = false;
+	InvalidateSnapshots();
+	if (UPortalTraversalSubsystem* TraversalSubsystem = GetWorld()->GetSubsystem<UPortalTraversalSubsystem>())
+	{
+		TraversalSubsystem->MarkDoorMoved(this);
+	}
+	if (APortalDoor* LinkDoor = GetLinkPortal())
+	{
+		LinkDoor->bThroughTransformValid = false;
+		LinkDoor->InvalidateSnapshots();
+	}
+}
+
+const FPortalThroughTransform& APortalDoor::GetThroughTransform()
+{
+	if (!bThroughTransformValid)
+	{
+		const APortalDoor* LinkDoor = GetLinkPortal();
+		ThroughTransform = LinkDoor ? FPortalThroughTransform(LinkDoor->GetActorTransform(), GetActorTransform()) : FPortalThroughTransform();
+		bThroughTransformValid = LinkDoor != nullptr;
+	}
+	return ThroughTransform;
+}
+
+void APortalDoor::AcquireMirrorProxy()
+{
+	ACharacter* Character = UGameplayStatics::GetPlayerCharacter(this,0);
+	UPortalMirrorPool* MirrorPool = UWorld::GetSubsystem<UPortalMirrorPool>(GetWorld());
+	if (MirrorProxyClass
+		&& !MirrorProxy
+		&& Character
+		&& MirrorPool)
+	{
+		MirrorProxy = MirrorPool->AcquireMirrorProxy(MirrorProxyClass, Character->GetMesh());
+	}
+}
+
+void APortalDoor::ReleaseMirrorProxy()
+{
+	if (!MirrorProxy)
+	{
+		return;
+	}
+
+	if (UPortalMirrorPool* MirrorPool = UWorld::GetSubsystem<UPortalMirrorPool>(GetWorld()))
+	{
+		MirrorPool->ReleaseMirrorProxy(MirrorProxy);
+	}
+	MirrorProxy = nullptr;
+}
+
+void APortalDoor::UpdatePortalCameraTransform()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor)
+	{
+		return;
+	}
+
+	APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this,0);
+	FTransform CameraTransform = CameraManager->GetTransform();
+	PortalCamera->SetRelativeTransform(CameraTransform * GetThroughTransform().GetRelativeTransform());
+
+	UpdatePortalProjection();
+}
+
+void APortalDoor::UpdatePortalProjection()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor)
+	{
+		return;
+	}
+
+	// MI_PortalPlane samples RTPortal in screen space, so x and y always follow the player projection
+	bool bUseCustomProjection = false;
+	const FPortalScreenFootprint& Footprint = LinkDoor->GetScreenFootprint();
+	if (LinkDoor->GetProjectionMode() == EPortalProjectionMode::Oblique && Footprint.bOnScreen)
+	{
+		PortalCameraProjection = Footprint.ProjectionMatrix;
+		const FMatrix ViewMatrix = MakeCaptureViewMatrix(PortalCamera->GetComponentTransform());
+		PortalCamera->CustomProjectionMatrix = MakeObliqueProjection(PortalCameraProjection, ViewMatrix, FPlane(GetActorLocation(), GetDoorForwardDirection()));
+		bUseCustomProjection = true;
+	}
+
+	PortalCamera->bUseCustomProjectionMatrix = bUseCustomProjection;
+}
+
+FMatrix APortalDoor::MakeCropProjection(const FMatrix& Projection, const FVector2D& UVMin, const FVector2D& UVSize)
+{
+	// NDC y points up, UV y points down
+	const double ScaleX = 1.0 / UVSize.X;
+	const double ScaleY = 1.0 / UVSize.Y;
+	const double CenterX = (UVMin.X + UVSize.X * 0.5) * 2.0 - 1.0;
+	const double CenterY = 1.0 - (UVMin.Y + UVSize.Y * 0.5) * 2.0;
+	const FMatrix Crop(
+		FPlane(ScaleX, 0.0, 0.0, 0.0),
+		FPlane(0.0, ScaleY, 0.0, 0.0),
+		FPlane(0.0, 0.0, 1.0, 0.0),
+		FPlane(-ScaleX * CenterX, -ScaleY * CenterY, 0.0, 1.0));
+	return Projection * Crop;
+}
+
+FMatrix APortalDoor::MakeCaptureViewMatrix(const FTransform& ViewTransform)
+{
+	// Same basis swap as the scene capture view: X forward becomes Z, Y right stays X, Z up becomes Y
+	return FTranslationMatrix(-ViewTransform.GetLocation())
+		* FInverseRotationMatrix(ViewTransform.Rotator())
+		* FMatrix(FPlane(0, 0, 1, 0), FPlane(1, 0, 0, 0), FPlane(0, 1, 0, 0), FPlane(0, 0, 0, 1));
+}
+
+FMatrix APortalDoor::MakeObliqueProjection(const FMatrix& Projection, const FMatrix& ViewMatrix, const FPlane& ClipPlane)
+{
+	// Replace the near plane of the reversed-Z projection with the door plane:
+	// z_clip <= w_clip becomes Scale * dot(Plane, v) >= 0. Scale keeps the derived
+	// far plane (z_clip >= 0) outside the frustum.
+	const FPlane ViewPlane = ClipPlane.TransformBy(ViewMatrix);
+	const FVector4 Plane4(ViewPlane.X, ViewPlane.Y, ViewPlane.Z, -ViewPlane.W);
+	const double TanX = (1.0 + FMath::Abs(Projection.M[2][0])) / Projection.M[0][0];
+	const double TanY = (1.0 + FMath::Abs(Projection.M[2][1])) / Projection.M[1][1];
+	const double Scale = 1.0 / FMath::Sqrt(1.0 + TanX * TanX + TanY * TanY);
+
+	FMatrix Result = Projection;
+	for (int32 Row = 0; Row < 4; ++Row)
+	{
+		Result.M[Row][2] = Projection.M[Row][3] - Scale * Plane4[Row];
+	}
+	return Result;
+}
+
+void APortalDoor::UpdateMirrorCharacterTrans()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	USkeletalMeshComponent* SourceMesh = MirrorProxy ? MirrorProxy->GetSourceMesh() : nullptr;
+	if (!LinkDoor || !SourceMesh)
+	{
+		return;
+	}
+
+	// The proxy root is the mesh itself, so mirror the source mesh rather than its actor
+	MirrorProxy->GetMesh()->SetWorldTransform(GetThroughTransform().TransformTransform(SourceMesh->GetComponentTransform()));
+}
+
+void APortalDoor::UpdateViewCameraTransform()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor)
+	{
+		return;
+	}
+	
+	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	auto CharacterCam = PCharacter->GetFollowCamera();
+	FTransform PlayerCameraTrans = CharacterCam->GetComponentTransform();
+
+	ViewCamera->SetWorldTransform(GetThroughTransform().TransformTransform(PlayerCameraTrans));
+}
+
+void APortalDoor::InitTextureTarget()
+{
+	// RTPortal itself is borrowed from UPortalRenderTargetPool while the door is active
+	if (!Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0)))
+	{
+		UMaterialInstanceDynamic* DynamicMat = UMaterialInstanceDynamic::Create(MI_PortalPlane, this);
+		Plane->SetMaterial(0, DynamicMat);
+	}
+
+	const UMaterialInterface* PlaneMaterial = Plane->GetMaterial(0);
+	float SnapshotValue;
+	bPlaneShowsSnapshots = PlaneMaterial && PlaneMaterial->GetScalarParameterValue(FHashedMaterialParameterInfo(TEXT("Snapshot")), SnapshotValue);
+	if (!bPlaneShowsSnapshots && IdleMode == EPortalIdleMode::Snapshot)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: the Plane material has no Snapshot parameter, idle doors stay blank."), *GetName());
+	}
+	
+	SetClipPlanes();
+}
+
+void APortalDoor::SetRenderTargetActive(const bool InActive)
+{
+	UMaterialInstanceDynamic* DynMat = Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0));
+	if (!DynMat)
+	{
+		return;
+	}
+	APortalDoor* OtherLinkPortal = GetLinkPortal();
+	if(!OtherLinkPortal)
+	{
+		return;
+	}
+	
+	float ActiveValue = InActive ? 1.0f : 0.0f;
+	DynMat->SetScalarParameterValue(TEXT("Active"), ActiveValue);
+	bRenderTargetActive = InActive;
+	const double Fraction = GetRenderTargetFraction();
+	SetRenderTargetLevel(!InActive ? INDEX_NONE
+		: Fraction > 0.0 ? GetRenderTargetLevelForFraction(Fraction) : FMath::Max(RenderTargetLevel, 0));
+	SetSnapshotActive(!InActive && GetIdleMode() == EPortalIdleMode::Snapshot);
+}
+
+EPortalIdleMode APortalDoor::GetIdleMode() const
+{
+	return bPlaneShowsSnapshots ? IdleMode : EPortalIdleMode::Blank;
+}
+
+void APortalDoor::InvalidateSnapshots()
+{
+	bSnapshotsValid = false;
+
+	// Idle doors would show the stale snapshots until they next go idle, a moving door invalidates every frame
+	if (HasActorBegunPlay() && !bRenderTargetActive && GetIdleMode() == EPortalIdleMode::Snapshot)
+	{
+		// The recapture draws into the same targets
+		if (!bSnapshotRecapturePending)
+		{
+			bSnapshotRecapturePending = true;
+			GetWorldTimerManager().SetTimerForNextTick(this, &APortalDoor::RecaptureSnapshots);
+		}
+		return;
+	}
+	ReleaseSnapshotTargets();
+}
+
+void APortalDoor::RecaptureSnapshots()
+{
+	bSnapshotRecapturePending = false;
+	if (!bRenderTargetActive && GetIdleMode() == EPortalIdleMode::Snapshot)
+	{
+		SetSnapshotActive(true);
+	}
+}
+
+void APortalDoor::ReleaseSnapshotTargets()
+{
+	if (SnapshotTargets.IsEmpty())
+	{
+		return;
+	}
+
+	if (UPortalRenderTargetPool* RenderTargetPool = UWorld::GetSubsystem<UPortalRenderTargetPool>(GetWorld()))
+	{
+		for (UTextureRenderTarget2D* Target : SnapshotTargets)
+		{
+			RenderTargetPool->ReleaseRenderTarget(Target);
+		}
+	}
+	SnapshotTargets.Reset();
+	SnapshotDirections.Reset();
+	bSnapshotsValid = false;
+
+	// The pool may hand the targets to another door
+	SnapshotView = INDEX_NONE;
+	if (UMaterialInstanceDynamic* DynMat = Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0)))
+	{
+		DynMat->SetTextureParameterValue(TEXT("SnapshotTexture"), nullptr);
+	}
+}
+
+void APortalDoor::SetSnapshotActive(const bool bInActive)
+{
+	UMaterialInstanceDynamic* DynMat = Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0));
+	if (!DynMat)
+	{
+		return;
+	}
+
+	if (bInActive && !bSnapshotsValid)
+	{
+		CaptureSnapshots();
+	}
+
+	bSnapshotActive = bInActive && bSnapshotsValid;
+	DynMat->SetScalarParameterValue(TEXT("Snapshot"), bSnapshotActive ? 1.0f : 0.0f);
+	SnapshotView = INDEX_NONE;
+	GetWorldTimerManager().ClearTimer(SnapshotTimer);
+	if (!bSnapshotActive)
+	{
+		return;
+	}
+
+	UpdateSnapshotView();
+	if (SnapshotTargets.Num() > 1)
+	{
+		// Picking a view is a handful of dot products, a few times a second is plenty
+		GetWorldTimerManager().SetTimer(SnapshotTimer, this, &APortalDoor::UpdateSnapshotView, 0.1f, true);
+	}
+}
+
+void APortalDoor::CaptureSnapshots()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor)
+	{
+		return;
+	}
+
+	UPortalRenderTargetPool* RenderTargetPool = UWorld::GetSubsystem<UPortalRenderTargetPool>(GetWorld());
+	if (!RenderTargetPool)
+	{
+		return;
+	}
+
+	// LDR with mips, half the live target's memory per texel and filtered at any distance
+	const int32 NumViews = FMath::Clamp(NumSnapshotViews, 1, 8);
+	const FIntPoint Size(SnapshotSize, SnapshotSize);
+	for (int32 View = NumViews; View < SnapshotTargets.Num(); ++View)
+	{
+		RenderTargetPool->ReleaseRenderTarget(SnapshotTargets[View]);
+	}
+	SnapshotTargets.SetNum(NumViews);
+	SnapshotDirections.SetNum(NumViews);
+	for (UTextureRenderTarget2D*& Target : SnapshotTargets)
+	{
+		if (!Target || Target->SizeX != Size.X)
+		{
+			RenderTargetPool->ReleaseRenderTarget(Target);
+			Target = RenderTargetPool->AcquireRenderTarget(Size, RTF_RGBA8, true);
+		}
+	}
+
+	// The link PortalCamera draws this door's view, keep its live state around the snapshots
+	USceneCaptureComponent2D* Capture = LinkDoor->PortalCamera;
+	UTextureRenderTarget2D* TextureTarget = Capture->TextureTarget;
+	const FTransform RelativeTransform = Capture->GetRelativeTransform();
+	const bool bUseCustomProjection = Capture->bUseCustomProjectionMatrix;
+	const FMatrix CustomProjection = Capture->CustomProjectionMatrix;
+	const TEnumAsByte<ESceneCaptureSource> CaptureSource = Capture->CaptureSource;
+	const bool bRenderInMainRenderer = Capture->bRenderInMainRenderer;
+
+	Capture->CaptureSource = SCS_FinalColorLDR;
+	Capture->bRenderInMainRenderer = false;
+	Capture->bUseCustomProjectionMatrix = true;
+
+	const FTransform DoorTransform = GetActorTransform();
+	const FVector Center = Plane->Bounds.Origin;
+	const FBox LocalBox = Plane->CalcLocalBounds().GetBox();
+	const FTransform PlaneTransform = Plane->GetComponentTransform();
+	const FPortalThroughTransform& Through = LinkDoor->GetThroughTransform();
+	const FMatrix BaseProjection = FReversedZPerspectiveMatrix(FMath::DegreesToRadians(60.0f), 1.0f, 1.0f, GNearClippingPlane);
+
+	for (int32 View = 0; View < NumViews; ++View)
+	{
+		const float Yaw = NumViews > 1 ? FMath::Lerp(-SnapshotMaxAngle, SnapshotMaxAngle, View / float(NumViews - 1)) : 0.0f;
+		const FVector Direction = GetDoorForwardDirection().RotateAngleAxis(Yaw, GetActorUpVector());
+		const FTransform EyeTransform(FRotationMatrix::MakeFromX(-Direction).ToQuat(), Center + Direction * SnapshotDistance);
+
+		// Frame exactly the Plane, so MI_PortalPlane maps the snapshot onto it without a screen rect
+		const FMatrix ViewProjection = MakeCaptureViewMatrix(EyeTransform) * BaseProjection;
+		FBox2D UVRect(ForceInit);
+		for (int32 Corner = 0; Corner < 8; ++Corner)
+		{
+			const FVector Sign((Corner & 1) ? 1.0 : -1.0, (Corner & 2) ? 1.0 : -1.0, (Corner & 4) ? 1.0 : -1.0);
+			const FVector Position = PlaneTransform.TransformPosition(LocalBox.GetCenter() + LocalBox.GetExtent() * Sign);
+			const FVector4 Clip = ViewProjection.TransformFVector4(FVector4(Position, 1.0));
+			const double W = FMath::Max(Clip.W, UE_KINDA_SMALL_NUMBER);
+			UVRect += FVector2D(Clip.X / W * 0.5 + 0.5, 0.5 - Clip.Y / W * 0.5);
+		}
+
+		Capture->TextureTarget = SnapshotTargets[View];
+		Capture->SetRelativeTransform(EyeTransform * Through.GetRelativeTransform());
+		Capture->CustomProjectionMatrix = MakeCropProjection(BaseProjection, UVRect.Min, UVRect.GetSize().ComponentMax(FVector2D(UE_KINDA_SMALL_NUMBER)));
+		Capture->CaptureScene();
+		SnapshotDirections[View] = DoorTransform.InverseTransformVectorNoScale(Direction);
+		INC_DWORD_STAT(STAT_PortalSnapshotCaptures);
+	}
+
+	Capture->TextureTarget = TextureTarget;
+	Capture->SetRelativeTransform(RelativeTransform);
+	Capture->bUseCustomProjectionMatrix = bUseCustomProjection;
+	Capture->CustomProjectionMatrix = CustomProjection;
+	Capture->CaptureSource = CaptureSource;
+	Capture->bRenderInMainRenderer = bRenderInMainRenderer;
+	bSnapshotsValid = true;
+}
+
+void APortalDoor::UpdateSnapshotView()
+{
+	const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this,0);
+	UMaterialInstanceDynamic* DynMat = Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0));
+	if (!bSnapshotActive || !CameraManager || !DynMat || SnapshotTargets.IsEmpty())
+	{
+		return;
+	}
+
+	const FVector ViewDirection = GetActorTransform().InverseTransformVectorNoScale(
+		(CameraManager->GetCameraLocation() - Plane->Bounds.Origin).GetSafeNormal());
+	int32 BestView = 0;
+	for (int32 View = 1; View < SnapshotDirections.Num(); ++View)
+	{
+		if ((SnapshotDirections[View] | ViewDirection) > (SnapshotDirections[BestView] | ViewDirection))
+		{
+			BestView = View;
+		}
+	}
+
+	if (BestView == SnapshotView)
+	{
+		return;
+	}
+
+	// MI_PortalPlane offsets the snapshot by the angle between its view and the current one
+	SnapshotView = BestView;
+	DynMat->SetTextureParameterValue(TEXT("SnapshotTexture"), SnapshotTargets[BestView]);
+	DynMat->SetVectorParameterValue(TEXT("SnapshotViewDirection"), FLinearColor(SnapshotDirections[BestView]));
+}
+
+void APortalDoor::SetRenderTargetLevel(int32 Level)
+{
+	UPortalRenderTargetPool* RenderTargetPool = UWorld::GetSubsystem<UPortalRenderTargetPool>(GetWorld());
+	if (!RenderTargetPool)
+	{
+		return;
+	}
+
+	UTextureRenderTarget2D* Target = nullptr;
+	if (Level == INDEX_NONE)
+	{
+		// Back to the pool, so memory follows the active doors
+		for (UTextureRenderTarget2D*& LevelTarget : LevelTargets)
+		{
+			RenderTargetPool->ReleaseRenderTarget(LevelTarget);
+			LevelTarget = nullptr;
+		}
+	}
+	else
+	{
+		// Clamped levels of the same size share one target
+		Level = FMath::Clamp(Level, 0, GetNumRenderTargetLevels() - 1);
+		const FIntPoint Size = GetRenderTargetLevelSize(Level);
+		while (Level > 0 && GetRenderTargetLevelSize(Level - 1) == Size)
+		{
+			--Level;
+		}
+
+		// Kept per door until it goes idle, switching back and forth never touches the pool
+		LevelTargets.SetNum(FMath::Max(LevelTargets.Num(), Level + 1));
+		if (!LevelTargets[Level])
+		{
+			LevelTargets[Level] = RenderTargetPool->AcquireRenderTarget(Size);
+		}
+		Target = LevelTargets[Level];
+	}
+
+	RenderTargetLevel = Target ? Level : INDEX_NONE;
+	RTPortal = Target;
+	SetPortalTexture(RTPortal);
+	if (APortalDoor* OtherLinkPortal = GetLinkPortal())
+	{
+		OtherLinkPortal->PortalCamera->TextureTarget = RTPortal;
+		ApplyCaptureSettings(OtherLinkPortal->PortalCamera);
+		if (!RTPortal)
+		{
+			OtherLinkPortal->ReleaseRecursionTargets();
+		}
+	}
+}
+
+int32 APortalDoor::GetNumRenderTargetLevels()
+{
+	return FMath::Clamp(CVarPortalAdaptiveResolutionLevels.GetValueOnGameThread(), 1, 8);
+}
+
+FIntPoint APortalDoor::GetRenderTargetLevelSize(const int32 Level) const
+{
+	if (!GEngine || !GEngine->GameViewport)
+	{
+		return FIntPoint::ZeroValue;
+	}
+
+	FVector2D ViewportSize;
+	GEngine->GameViewport->GetViewportSize(ViewportSize);
+	if (ViewportSize.GetMax() <= 0.0)
+	{
+		return FIntPoint::ZeroValue;
+	}
+
+	// Viewport aspect at 1 / 2^Level of its size, long side within the door's clamps
+	FVector2D TargetSize = ViewportSize * FMath::Pow(0.5, Level);
+	const double LongSide = FMath::Max(TargetSize.GetMax(), 1.0);
+	TargetSize *= FMath::Clamp<double>(LongSide, MinRenderTargetSize, MaxRenderTargetSize) / LongSide;
+	return FIntPoint(FMath::CeilToInt(TargetSize.X), FMath::CeilToInt(TargetSize.Y)).ComponentMin(FIntPoint(ViewportSize.X, ViewportSize.Y));
+}
+
+void APortalDoor::PrewarmRenderTargets() const
+{
+	UPortalRenderTargetPool* RenderTargetPool = UWorld::GetSubsystem<UPortalRenderTargetPool>(GetWorld());
+	if (!RenderTargetPool || !GEngine || !GEngine->GameViewport)
+	{
+		return;
+	}
+
+	FVector2D ViewportSize;
+	GEngine->GameViewport->GetViewportSize(ViewportSize);
+	TArray<FIntPoint, TInlineAllocator<8>> Sizes;
+	for (int32 Level = 0; Level < GetNumRenderTargetLevels(); ++Level)
+	{
+		const FIntPoint Size = GetRenderTargetLevelSize(Level);
+		if (Size.GetMin() > 0)
+		{
+			Sizes.AddUnique(Size);
+		}
+	}
+	RenderTargetPool->PrewarmRenderTargets(FIntPoint(ViewportSize.X, ViewportSize.Y), Sizes);
+}
+
+void APortalDoor::SetPortalTexture(UTexture* Texture)
+{
+	if (UMaterialInstanceDynamic* DynMat = Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0)))
+	{
+		DynMat->SetTextureParameterValue(TEXT("Texture"), Texture);
+	}
+}
+
+void APortalDoor::ApplyCaptureSettings(USceneCaptureComponent2D* Capture) const
+{
+	const APortalDoor* LinkDoor = GetLinkPortal();
+	if (!Capture || !LinkDoor)
+	{
+		return;
+	}
+
+	// Queued with CaptureSceneDeferred and rendered by the main renderer along with the player view
+	Capture->bRenderInMainRenderer = bCaptureInMainView;
+	Capture->bMainViewFamily = bCaptureInMainView;
+
+	const FPortalCaptureLOD* LOD = CaptureLODs.IsValidIndex(CaptureLOD) ? &CaptureLODs[CaptureLOD] : nullptr;
+	if (LOD)
+	{
+		// Only component properties change, so switching tiers never recreates render resources
+		Capture->ShowFlags.SetDynamicShadows(LOD->bDynamicShadows);
+		Capture->ShowFlags.SetAmbientOcclusion(LOD->bAmbientOcclusion);
+		Capture->ShowFlags.SetVolumetricFog(LOD->bVolumetricFog);
+		Capture->ShowFlags.SetBloom(LOD->bBloom);
+		Capture->LODDistanceFactor = LOD->LODDistanceFactor;
+		Capture->MaxViewDistanceOverride = LOD->MaxViewDistanceOverride;
+	}
+
+	Capture->ShowFlags.SetMotionBlur(CaptureFeatures.bMotionBlur);
+	Capture->ShowFlags.SetEyeAdaptation(CaptureFeatures.bAutoExposure);
+
+	// The tier picks the methods, CaptureFeatures can still take Lumen away
+	EDynamicGlobalIlluminationMethod::Type GIMethod = LOD ? LOD->DynamicGlobalIlluminationMethod.GetValue() : EDynamicGlobalIlluminationMethod::Lumen;
+	EReflectionMethod::Type ReflectionMethod = LOD ? LOD->ReflectionMethod.GetValue() : EReflectionMethod::Lumen;
+	if (!CaptureFeatures.bLumen)
+	{
+		GIMethod = GIMethod == EDynamicGlobalIlluminationMethod::Lumen ? EDynamicGlobalIlluminationMethod::None : GIMethod;
+		ReflectionMethod = ReflectionMethod == EReflectionMethod::Lumen ? EReflectionMethod::ScreenSpace : ReflectionMethod;
+	}
+
+	FPostProcessSettings& Settings = Capture->PostProcessSettings;
+	Settings.bOverride_DynamicGlobalIlluminationMethod = LOD || !CaptureFeatures.bLumen;
+	Settings.DynamicGlobalIlluminationMethod = GIMethod;
+	Settings.bOverride_ReflectionMethod = LOD || !CaptureFeatures.bLumen;
+	Settings.ReflectionMethod = ReflectionMethod;
+}
+
+void APortalDoor::UpdateCaptureLOD()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this,0);
+	if (CaptureLODs.IsEmpty() || !LinkDoor || !CameraManager)
+	{
+		return;
+	}
+
+	const double Distance = FMath::Sqrt(Plane->Bounds.GetBox().ComputeSquaredDistanceToPoint(CameraManager->GetCameraLocation()));
+	const FPortalScreenFootprint& Footprint = GetScreenFootprint();
+	const float Coverage = Footprint.bFullScreen ? 1.0f : Footprint.Coverage;
+
+	// The current tier holds within a wider band, so a camera on a threshold doesn't switch tiers every frame
+	const float Hysteresis = FMath::Clamp(CVarPortalCaptureLODHysteresis.GetValueOnGameThread(), 0.0f, 0.9f);
+	int32 NewCaptureLOD = CaptureLODs.Num() - 1;
+	for (int32 Index = 0; Index < CaptureLODs.Num(); ++Index)
+	{
+		const FPortalCaptureLOD& LOD = CaptureLODs[Index];
+		const float Band = Index == CaptureLOD ? Hysteresis : 0.0f;
+		if (LOD.MaxDistance <= 0.0f || Distance <= LOD.MaxDistance * (1.0f + Band)
+			|| (LOD.MinCoverage > 0.0f && Coverage >= LOD.MinCoverage * (1.0f - Band)))
+		{
+			NewCaptureLOD = Index;
+			break;
+		}
+	}
+
+	if (NewCaptureLOD != CaptureLOD)
+	{
+		CaptureLOD = NewCaptureLOD;
+		ApplyCaptureSettings(LinkDoor->PortalCamera);
+	}
+}
+
+void APortalDoor::UpdatePortalRendering()
+{
+	if (APortalDoor* LinkDoor = GetLinkPortal())
+	{
+		LinkDoor->UpdateCaptureLOD();
+	}
+	UpdatePortalProjection();
+	UpdateRenderTargetResolution();
+	UpdatePortalCapture();
+}
+
+void APortalDoor::SetViewUpdate(const EPortalViewUpdate InViewUpdate)
+{
+	if (ViewUpdate == InViewUpdate)
+	{
+		return;
+	}
+
+	ViewUpdate = InViewUpdate;
+	if (UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld()))
+	{
+		PortalSubsystem->SetPortalViewUpdate(this, InViewUpdate);
+	}
+}
+
+void APortalDoor::UpdatePortalCapture()
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor || !PortalCamera->TextureTarget)
+	{
+		return;
+	}
+
+	if (CVarPortalSkipHiddenCaptures.GetValueOnGameThread() && !LinkDoor->IsPlaneVisible())
+	{
+		INC_DWORD_STAT(STAT_PortalSkippedCaptures);
+		return;
+	}
+
+	const FTransform CaptureTransform = PortalCamera->GetComponentTransform();
+	const FMatrix Projection = PortalCamera->bUseCustomProjectionMatrix
+		? PortalCamera->CustomProjectionMatrix : LinkDoor->GetScreenFootprint().ProjectionMatrix;
+	UTextureRenderTarget2D* TextureTarget = PortalCamera->TextureTarget;
+	const uint32 SceneHash = CVarPortalDirtyTracking.GetValueOnGameThread() ? HashCaptureScene(CaptureTransform, Projection) : 0;
+
+	// A fresh or recycled target has no usable content yet
+	const uint64 MaxStaleFrames = FMath::Max(1, CVarPortalMaxStaleFrames.GetValueOnGameThread());
+	if (LastCaptureTarget.Get() == TextureTarget && GFrameCounter - LastCaptureFrame < MaxStaleFrames)
+	{
+		const bool bViewChanged = !CaptureTransform.Equals(LastCaptureTransform, UE_KINDA_SMALL_NUMBER)
+			|| !Projection.Equals(LastCaptureProjection, UE_KINDA_SMALL_NUMBER);
+		if (!bViewChanged && CVarPortalDirtyTracking.GetValueOnGameThread() && SceneHash == LastCaptureSceneHash)
+		{
+			INC_DWORD_STAT(STAT_PortalUnchangedCaptures);
+			return;
+		}
 
-	ViewCamera = CreateDefaultSubobject<UCameraComponent>("PlayerCamera");
-	ViewCamera->SetupAttachment(RootComponent);
+		if (IsCaptureThrottled(LinkDoor, bViewChanged))
+		{
+			INC_DWORD_STAT(STAT_PortalThrottledCaptures);
+			return;
+		}
+	}
 
-	CrossingDetectionBox = CreateDefaultSubobject<UBoxComponent>("CrossingDetectionBox");
-	CrossingDetectionBox->SetupAttachment(RootComponent);
+	LastCaptureTransform = CaptureTransform;
+	LastCaptureProjection = Projection;
+	LastCaptureTarget = TextureTarget;
+	LastCaptureSceneHash = SceneHash;
+	LastCaptureFrame = GFrameCounter;
 
-	ActivateDetectionBox = CreateDefaultSubobject<UBoxComponent>("ActivateDetectionBox");
-	ActivateDetectionBox->SetupAttachment(RootComponent);
+	// Deferred captures can't be chained
+	if (LinkDoor->IsCaptureInMainView())
+	{
+		ReleaseRecursionTargets();
+	}
+	else
+	{
+		UpdateRecursiveCaptures(LinkDoor);
+	}
 
-	StateMachine = CreateDefaultSubobject<UStateMachineComponent>("StateMachineComponent");
+	// The link Plane shows the second level while the first one is captured
+	if (RecursionTargets.Num() > 0)
+	{
+		LinkDoor->SetPortalTexture(RecursionTargets[0]);
+	}
+	if (LinkDoor->IsCaptureInMainView())
+	{
+		PortalCamera->CaptureSceneDeferred();
+	}
+	else
+	{
+		PortalCamera->CaptureScene();
+	}
+	if (RecursionTargets.Num() > 0)
+	{
+		LinkDoor->SetPortalTexture(TextureTarget);
+	}
+	INC_DWORD_STAT(STAT_PortalCaptures);
 }
 
-void APortalDoor::PostInitializeComponents()
+bool APortalDoor::IsCaptureThrottled(const APortalDoor* LinkDoor, const bool bViewChanged) const
 {
-	Super::PostInitializeComponents();
-	Tags.Add(PortalTag);
-}
+	const int32 Interval = CVarPortalThrottleInterval.GetValueOnGameThread();
+	if (Interval <= 1)
+	{
+		return false;
+	}
 
-void APortalDoor::BeginPlay()
-{
-	Super::BeginPlay();
-	
-	if (GEngine && GEngine->GameViewport)
+	// A static view only needs updates for moving primitives, which tolerate a lower rate
+	if (bViewChanged)
 	{
-		FViewport* Viewport = GEngine->GameViewport->Viewport;
-		Viewport->ViewportResizedEvent.AddUObject(this, &APortalDoor::OnViewportResized);
+		const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this,0);
+		const float Distance = CVarPortalThrottleDistance.GetValueOnGameThread();
+		if (!CameraManager || FVector::DistSquared(CameraManager->GetCameraLocation(), LinkDoor->GetActorLocation()) <= FMath::Square(Distance))
+		{
+			return false;
+		}
 	}
-	
-	InitTextureTarget();
-	
-	ActivateDetectionBox->OnComponentBeginOverlap.AddDynamic(this, &APortalDoor::OnActivateBoxOverlapBegin);
-	ActivateDetectionBox->OnComponentEndOverlap.AddDynamic(this, &APortalDoor::OnActivateBoxOverlapEnd);
-	CrossingDetectionBox->OnComponentBeginOverlap.AddDynamic(this, &APortalDoor::OnCrossBoxOverlapBegin);
-	CrossingDetectionBox->OnComponentEndOverlap.AddDynamic(this, &APortalDoor::OnCrossBoxOverlapEnd);
+
+	// Staggered, so throttled doors don't all capture on the same frame
+	return (GFrameCounter + GetUniqueID()) % Interval != 0;
 }
 
-void APortalDoor::CreateMirrorCharacter()
+uint32 APortalDoor::HashCaptureScene(const FTransform& ViewTransform, const FMatrix& Projection) const
 {
-	if (MirrorCharacterClass
-		&& !MirrorCharacter)
+	const UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+	if (!PortalSubsystem)
 	{
-		FActorSpawnParameters ActorSpawnParams;
-		ActorSpawnParams.Owner = this;
-		APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
-		MirrorCharacter = GetWorld()->SpawnActor<ACharacter>(MirrorCharacterClass,GetActorLocation(),GetActorRotation(),ActorSpawnParams);
-		auto MirrorAnimInst = Cast<UMirrorAnimInstance>(MirrorCharacter->GetMesh()->GetAnimInstance());
-		ensure(MirrorAnimInst);
-		MirrorAnimInst->SourceMesh = PCharacter->GetMesh();
-		MirrorCharacter->SetActorHiddenInGame(true);
+		return 0;
 	}
+
+	FConvexVolume ViewFrustum;
+	GetViewFrustumBounds(ViewFrustum, MakeCaptureViewMatrix(ViewTransform) * Projection, false);
+
+	// Registered movers instead of a scene query: no per door collision work, and primitives without collision count too
+	uint32 Hash = 0;
+	for (const TWeakObjectPtr<AActor>& CaptureMover : PortalSubsystem->GetCaptureMovers())
+	{
+		const AActor* Mover = CaptureMover.Get();
+		if (!Mover || Mover->IsHidden())
+		{
+			continue;
+		}
+
+		Mover->ForEachComponent<UPrimitiveComponent>(false, [&ViewFrustum, &Hash](const UPrimitiveComponent* Primitive)
+		{
+			if (!Primitive->IsRegistered() || !Primitive->IsVisible()
+				|| !ViewFrustum.IntersectBox(Primitive->Bounds.Origin, Primitive->Bounds.BoxExtent))
+			{
+				return;
+			}
+
+			// Combine per primitive hashes order independently, registration order changes with swaps
+			const FVector Location = Primitive->GetComponentLocation();
+			const FQuat Rotation = Primitive->GetComponentQuat();
+			uint32 PrimitiveHash = GetTypeHash(Primitive);
+			PrimitiveHash = FCrc::MemCrc32(&Location, sizeof(Location), PrimitiveHash);
+			PrimitiveHash = FCrc::MemCrc32(&Rotation, sizeof(Rotation), PrimitiveHash);
+			if (Primitive->IsA<USkinnedMeshComponent>() || Primitive->IsA<UFXSystemComponent>())
+			{
+				// Animates in place
+				PrimitiveHash = HashCombineFast(PrimitiveHash, GetTypeHash(GFrameCounter));
+			}
+			Hash ^= PrimitiveHash;
+		});
+	}
+	return Hash;
 }
 
-FTransform APortalDoor::CalculateMirroredRelativeTrans(const FTransform& InTransform, const FTransform& BaseTransform)
+void APortalDoor::UpdateRecursiveCaptures(APortalDoor* LinkDoor)
 {
-	FTransform LocalTrans = InTransform.GetRelativeTransform(BaseTransform);
-	const FVector UpVector = BaseTransform.GetRotation().GetUpVector();
-	FQuat RotUp180Quat(UpVector, FMath::DegreesToRadians(180.0f));
-	FTransform  FMirroredLocalTrans;
-	FMirroredLocalTrans.SetLocation(RotUp180Quat.RotateVector(LocalTrans.GetLocation()));
-	FMirroredLocalTrans.SetRotation(RotUp180Quat * LocalTrans.GetRotation());
+	const int32 MaxDepth = FMath::Clamp(CVarPortalRecursionMaxDepth.GetValueOnGameThread(), 0, 8);
+	UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld());
+	if (MaxDepth == 0 || !PortalSubsystem)
+	{
+		ReleaseRecursionTargets(0);
+		return;
+	}
 
-	return FMirroredLocalTrans;
+	// Each level is the previous capture seen through the link Plane again
+	const FTransform CaptureTransform = PortalCamera->GetComponentTransform();
+	const FMatrix Projection = PortalCamera->bUseCustomProjectionMatrix
+		? PortalCameraProjection : LinkDoor->GetScreenFootprint().ProjectionMatrix;
+	TArray<FTransform, TInlineAllocator<8>> LevelTransforms;
+	const FPortalThroughTransform& Through = GetThroughTransform();
+	FTransform LevelTransform = CaptureTransform;
+	while (LevelTransforms.Num() < MaxDepth && IsLinkPlaneInCaptureView(LinkDoor, LevelTransform, Projection))
+	{
+		LevelTransform = Through.TransformTransform(LevelTransform);
+		LevelTransforms.Add(LevelTransform);
+	}
+
+	// Levels which don't fit in the budget are dropped, the deepest rendered one shows last frame's capture
+	UTextureRenderTarget2D* TextureTarget = PortalCamera->TextureTarget;
+	const float ResolutionScale = FMath::Clamp(CVarPortalRecursionResolutionScale.GetValueOnGameThread(), 0.1f, 1.0f);
+	TArray<FIntPoint, TInlineAllocator<8>> LevelSizes;
+	int64 RemainingPixels = CVarPortalRecursionPixelBudget.GetValueOnGameThread() - PortalSubsystem->GetRecursionPixels();
+	for (int32 Level = 0; Level < LevelTransforms.Num(); ++Level)
+	{
+		const float Scale = FMath::Pow(ResolutionScale, Level + 1);
+		const FIntPoint Size(FMath::Max(16, FMath::RoundToInt32(TextureTarget->SizeX * Scale)),
+			FMath::Max(16, FMath::RoundToInt32(TextureTarget->SizeY * Scale)));
+		RemainingPixels -= int64(Size.X) * Size.Y;
+		if (RemainingPixels < 0)
+		{
+			break;
+		}
+		LevelSizes.Add(Size);
+	}
+	const int32 Depth = LevelSizes.Num();
+	ReleaseRecursionTargets(Depth);
+	if (Depth == 0)
+	{
+		return;
+	}
+
+	UPortalRenderTargetPool* RenderTargetPool = UWorld::GetSubsystem<UPortalRenderTargetPool>(GetWorld());
+	RecursionTargets.SetNum(Depth);
+	for (int32 Level = 0; Level < Depth; ++Level)
+	{
+		const FIntPoint& Size = LevelSizes[Level];
+		UTextureRenderTarget2D*& LevelTarget = RecursionTargets[Level];
+		if (!LevelTarget || LevelTarget->SizeX != Size.X || LevelTarget->SizeY != Size.Y)
+		{
+			UTextureRenderTarget2D* OldTarget = LevelTarget;
+			LevelTarget = RenderTargetPool->AcquireRenderTarget(Size);
+			RenderTargetPool->ReleaseRenderTarget(OldTarget);
+		}
+	}
+
+	const FEngineShowFlags ShowFlags = PortalCamera->ShowFlags;
+	const FMatrix CustomProjection = PortalCamera->CustomProjectionMatrix;
+	const bool bOblique = PortalCamera->bUseCustomProjectionMatrix && LinkDoor->GetProjectionMode() == EPortalProjectionMode::Oblique;
+	const FPlane ClipPlane(GetActorLocation(), GetDoorForwardDirection());
+
+	for (int32 Level = Depth - 1; Level >= 0; --Level)
+	{
+		// Deepest level falls back to whatever was rendered last
+		LinkDoor->SetPortalTexture(Level + 1 < Depth ? RecursionTargets[Level + 1] : TextureTarget);
+		PortalCamera->TextureTarget = RecursionTargets[Level];
+		PortalCamera->SetWorldTransform(LevelTransforms[Level]);
+		if (bOblique)
+		{
+			PortalCamera->CustomProjectionMatrix = MakeObliqueProjection(PortalCameraProjection, MakeCaptureViewMatrix(LevelTransforms[Level]), ClipPlane);
+		}
+		PortalCamera->ShowFlags = ShowFlags;
+		ReduceRecursionShowFlags(PortalCamera->ShowFlags, Level + 2);
+		PortalCamera->CaptureScene();
+		INC_DWORD_STAT(STAT_PortalRecursiveCaptures);
+		PortalSubsystem->AddRecursionPixels(int64(LevelSizes[Level].X) * LevelSizes[Level].Y);
+	}
+
+	PortalCamera->TextureTarget = TextureTarget;
+	PortalCamera->SetWorldTransform(CaptureTransform);
+	PortalCamera->CustomProjectionMatrix = CustomProjection;
+	PortalCamera->ShowFlags = ShowFlags;
+	LinkDoor->SetPortalTexture(TextureTarget);
 }
 
-void APortalDoor::UpdatePortalCameraTransform()
+bool APortalDoor::IsLinkPlaneInCaptureView(const APortalDoor* LinkDoor, const FTransform& ViewTransform, const FMatrix& Projection) const
 {
-	APortalDoor* LinkDoor = GetLinkPortal();
-	if (!LinkDoor)
+	// The link Plane has to face the view and lie on the kept side of this door's clip plane
+	const FVector LinkLocation = LinkDoor->GetActorLocation();
+	if (FVector::DotProduct(ViewTransform.GetLocation() - LinkLocation, LinkDoor->GetDoorForwardDirection()) <= 0.0
+		|| FVector::DotProduct(LinkLocation - GetActorLocation(), GetDoorForwardDirection()) <= 0.0)
 	{
-		return;
+		return false;
 	}
 
-	APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this,0);
-	FTransform CameraTransform = CameraManager->GetTransform();
-	FTransform  FMirroredLocalTrans = CalculateMirroredRelativeTrans(CameraTransform,LinkDoor->GetActorTransform());
-	PortalCamera->SetRelativeTransform(FMirroredLocalTrans);
+	FConvexVolume ViewFrustum;
+	GetViewFrustumBounds(ViewFrustum, MakeCaptureViewMatrix(ViewTransform) * Projection, false);
+	const FBoxSphereBounds& Bounds = LinkDoor->Plane->Bounds;
+	return ViewFrustum.IntersectBox(Bounds.Origin, Bounds.BoxExtent);
 }
 
-void APortalDoor::UpdateMirrorCharacterTrans()
+void APortalDoor::ReleaseRecursionTargets(const int32 NumToKeep)
 {
-	APortalDoor* LinkDoor = GetLinkPortal();
-	if (!LinkDoor)
+	if (RecursionTargets.Num() <= NumToKeep)
 	{
 		return;
 	}
 
-	auto* Character = UGameplayStatics::GetPlayerCharacter(this,0);
-	FTransform CharacterTransform = Character->GetActorTransform();
-	FTransform  FMirroredLocalTrans = CalculateMirroredRelativeTrans(CharacterTransform,LinkDoor->GetActorTransform());
-	MirrorCharacter->SetActorTransform(FMirroredLocalTrans * GetActorTransform());
+	UPortalRenderTargetPool* RenderTargetPool = UWorld::GetSubsystem<UPortalRenderTargetPool>(GetWorld());
+	for (int32 Level = NumToKeep; Level < RecursionTargets.Num(); ++Level)
+	{
+		if (RenderTargetPool)
+		{
+			RenderTargetPool->ReleaseRenderTarget(RecursionTargets[Level]);
+		}
+	}
+	RecursionTargets.SetNum(NumToKeep);
 }
 
-void APortalDoor::UpdateViewCameraTransform()
+bool APortalDoor::IntersectPlaneSegment(const FVector& Start, const FVector& End, double& OutTime) const
 {
-	APortalDoor* LinkDoor = GetLinkPortal();
-	if (!LinkDoor)
+	const FVector Normal = GetDoorForwardDirection();
+	const double StartSide = FVector::DotProduct(Start - GetActorLocation(), Normal);
+	const double EndSide = FVector::DotProduct(End - GetActorLocation(), Normal);
+	if (StartSide < 0.0 || EndSide >= 0.0)
 	{
-		return;
+		return false;
 	}
-	
-	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
-	auto CharacterCam = PCharacter->GetFollowCamera();
-	FTransform PlayerCameraTrans = CharacterCam->GetComponentTransform();
-	FTransform  FMirroredLocalTrans = CalculateMirroredRelativeTrans(PlayerCameraTrans,LinkDoor->GetActorTransform());
 
-	ViewCamera->SetWorldTransform(FMirroredLocalTrans * GetActorTransform());
+	OutTime = StartSide / (StartSide - EndSide);
+	const FBoxSphereBounds& Bounds = Plane->Bounds;
+	const FVector ToCenter = FMath::Lerp(Start, End, OutTime) - Bounds.Origin;
+	const FVector Right = GetActorRightVector();
+	const FVector Up = GetActorUpVector();
+	return FMath::Abs(FVector::DotProduct(ToCenter, Right)) <= FVector::DotProduct(Right.GetAbs(), Bounds.BoxExtent)
+		&& FMath::Abs(FVector::DotProduct(ToCenter, Up)) <= FVector::DotProduct(Up.GetAbs(), Bounds.BoxExtent);
 }
 
-void APortalDoor::InitTextureTarget()
+bool APortalDoor::IsPlaneVisible()
 {
-	if (!RTPortal)
+	const FPortalScreenFootprint& Footprint = GetScreenFootprint();
+	if (!Footprint.bInFrustum)
 	{
-		RTPortal = NewObject<UTextureRenderTarget2D>(this);
-		UMaterialInstanceDynamic* DynamicMat = UMaterialInstanceDynamic::Create(MI_PortalPlane, this);
-		DynamicMat->SetTextureParameterValue(FName("Texture"),RTPortal);
-		Plane->SetMaterial(0, DynamicMat);
+		return false;
 	}
-	
-	SetClipPlanes();
+
+	// Occlusion results are only meaningful if the plane was already in view last frame
+	if (!Footprint.bWasInFrustum)
+	{
+		return true;
+	}
+
+	const UWorld* World = GetWorld();
+	const float Tolerance = World->GetDeltaSeconds() * 2.0f + UE_KINDA_SMALL_NUMBER;
+	return World->GetTimeSeconds() - Plane->GetLastRenderTimeOnScreen() <= Tolerance;
 }
 
-void APortalDoor::SetRenderTargetActive(const bool InActive)
+void APortalDoor::UpdateRenderTargetResolution()
 {
-	UMaterialInstanceDynamic* DynMat = Cast<UMaterialInstanceDynamic>(Plane->GetMaterial(0));
-	if (!DynMat)
+	if (!RTPortal || !bRenderTargetActive)
 	{
 		return;
 	}
-	APortalDoor* OtherLinkPortal = GetLinkPortal();
-	if(!OtherLinkPortal)
+
+	// Grow right away, only shrink once the footprint dropped clearly below the next level
+	const double Fraction = GetRenderTargetFraction();
+	if (Fraction <= 0.0)
 	{
 		return;
 	}
-	
-	float ActiveValue = InActive ? 1.0f : 0.0f;
-	DynMat->SetScalarParameterValue(TEXT("Active"), ActiveValue);
-	OtherLinkPortal->PortalCamera->TextureTarget = InActive ? RTPortal : nullptr;
-	if (GEngine && GEngine->GameViewport)
+	const float Hysteresis = FMath::Clamp(CVarPortalAdaptiveResolutionHysteresis.GetValueOnGameThread(), 0.0f, 0.9f);
+	const int32 GrowLevel = GetRenderTargetLevelForFraction(Fraction);
+	const int32 ShrinkLevel = GetRenderTargetLevelForFraction(Fraction / (1.0 - Hysteresis));
+	const int32 Level = GrowLevel < RenderTargetLevel ? GrowLevel : FMath::Max(ShrinkLevel, RenderTargetLevel);
+	if (GetRenderTargetLevelSize(Level) != GetRenderTargetLevelSize(RenderTargetLevel))
 	{
-		FVector2D ViewportSize;
-		GEngine->GameViewport->GetViewportSize(ViewportSize);
-		int32 Width = ViewportSize.X;
-		int32 Height = ViewportSize.Y;
-		RTPortal->InitAutoFormat(Width, Height);
-		RTPortal->ResizeTarget(Width, Height);
-		RTPortal->UpdateResourceImmediate(true);
+		INC_DWORD_STAT(STAT_PortalResolutionChanges);
+		SetRenderTargetLevel(Level);
 	}
 }
 
-APortalDoor* APortalDoor::GetLinkPortal() 
+const FPortalScreenFootprint& APortalDoor::GetScreenFootprint()
 {
-	if(LinkPortal.IsValid())
+	if (ScreenFootprintFrame == GFrameCounter)
 	{
-		return LinkPortal.Get();
+		return ScreenFootprint;
 	}
-	
-	TArray<AActor*> OutActor{};
-	UGameplayStatics::GetAllActorsOfClassWithTag(this,StaticClass(),LinkPortalTag,OutActor);
-	if(OutActor.Num() > 0)
+	const bool bWasInFrustum = ScreenFootprintFrame + 1 == GFrameCounter && ScreenFootprint.bInFrustum;
+	ScreenFootprintFrame = GFrameCounter;
+	ScreenFootprint = FPortalScreenFootprint();
+	ScreenFootprint.bWasInFrustum = bWasInFrustum;
+
+	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(this,0);
+	ULocalPlayer* LocalPlayer = PlayerController ? PlayerController->GetLocalPlayer() : nullptr;
+	if (!LocalPlayer || !LocalPlayer->ViewportClient || !LocalPlayer->ViewportClient->Viewport)
+	{
+		return ScreenFootprint;
+	}
+
+	FSceneViewProjectionData ProjectionData;
+	if (!LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+	{
+		return ScreenFootprint;
+	}
+
+	const FIntRect ViewRect = ProjectionData.GetConstrainedViewRect();
+	const FBox2D ViewBox(FVector2D(ViewRect.Min), FVector2D(ViewRect.Max));
+	const FMatrix ViewProjection = ProjectionData.ComputeViewProjectionMatrix();
+	ScreenFootprint.ViewRect = ViewRect;
+	ScreenFootprint.ProjectionMatrix = ProjectionData.ProjectionMatrix;
+
+	const FBoxSphereBounds& Bounds = Plane->Bounds;
+	FConvexVolume ViewFrustum;
+	GetViewFrustumBounds(ViewFrustum, ViewProjection, false);
+	ScreenFootprint.bInFrustum = ViewFrustum.IntersectBox(Bounds.Origin, Bounds.BoxExtent);
+	if (!ScreenFootprint.bInFrustum)
+	{
+		return ScreenFootprint;
+	}
+
+	FBox2D Rect(ForceInit);
+	for (int32 Corner = 0; Corner < 8; ++Corner)
 	{
-		if(APortalDoor* FindDoor = Cast<APortalDoor>(OutActor[0]))
+		const FVector Sign((Corner & 1) ? 1.0 : -1.0, (Corner & 2) ? 1.0 : -1.0, (Corner & 4) ? 1.0 : -1.0);
+		const FVector4 Clip = ViewProjection.TransformFVector4(FVector4(Bounds.Origin + Bounds.BoxExtent * Sign, 1.0));
+		if (Clip.W <= UE_KINDA_SMALL_NUMBER)
 		{
-			LinkPortal = FindDoor;
-			return FindDoor;
+			// Part of the plane is behind the view origin, assume it covers the whole view
+			ScreenFootprint.ScreenRect = ViewBox;
+			ScreenFootprint.Coverage = 1.0f;
+			ScreenFootprint.bOnScreen = true;
+			ScreenFootprint.bFullScreen = true;
+			return ScreenFootprint;
 		}
+
+		const double NDCX = Clip.X / Clip.W;
+		const double NDCY = Clip.Y / Clip.W;
+		Rect += FVector2D(ViewRect.Min.X + (NDCX * 0.5 + 0.5) * ViewRect.Width(),
+			ViewRect.Min.Y + (0.5 - NDCY * 0.5) * ViewRect.Height());
 	}
-	
-	return nullptr;
+
+	ScreenFootprint.bOnScreen = Rect.Intersect(ViewBox);
+	if (ScreenFootprint.bOnScreen)
+	{
+		ScreenFootprint.ScreenRect = FBox2D(FVector2D::Max(Rect.Min, ViewBox.Min), FVector2D::Min(Rect.Max, ViewBox.Max));
+		const FVector2D Size = ScreenFootprint.ScreenRect.GetSize();
+		ScreenFootprint.Coverage = Size.X * Size.Y / FMath::Max(ViewRect.Area(), 1);
+	}
+	return ScreenFootprint;
+}
+
+double APortalDoor::GetRenderTargetFraction()
+{
+	double Fraction = 1.0;
+	if (CVarPortalAdaptiveResolution.GetValueOnGameThread())
+	{
+		const FPortalScreenFootprint& Footprint = GetScreenFootprint();
+		if (!Footprint.bOnScreen)
+		{
+			// Not visible, no reason to touch the target
+			return RTPortal ? 0.0 : FMath::Pow(0.5, GetNumRenderTargetLevels() - 1);
+		}
+		Fraction = Footprint.bFullScreen ? 1.0 : GetRenderTargetFractionForCoverage(Footprint.Coverage);
+	}
+
+	if (CaptureLODs.IsValidIndex(CaptureLOD))
+	{
+		Fraction *= FMath::Clamp(CaptureLODs[CaptureLOD].ResolutionScale, 0.1f, 1.0f);
+	}
+	return Fraction;
+}
+
+double APortalDoor::GetRenderTargetFractionForCoverage(const float Coverage)
+{
+	// FullView targets are sampled in screen space, keep the texel count in line with the covered pixel count
+	return FMath::Sqrt(FMath::Clamp(Coverage, 0.0f, 1.0f));
+}
+
+int32 APortalDoor::GetRenderTargetLevelForFraction(const double Fraction)
+{
+	// Smallest level still at least Fraction of the viewport: 2^-Level >= Fraction
+	const int32 Level = FMath::FloorToInt32(FMath::Log2(1.0 / FMath::Max(Fraction, UE_SMALL_NUMBER)));
+	return FMath::Clamp(Level, 0, GetNumRenderTargetLevels() - 1);
 }
 
 USceneCaptureComponent2D* APortalDoor::GetLinkPortalCamera()
@@ -228,11 +1362,44 @@ void APortalDoor::SetClipPlanes() const
 	PortalCamera->ClipPlaneBase = GetActorLocation();
 }
 
-void APortalDoor::OnActivateBoxOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
-                                            UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void APortalDoor::EnterActivation()
 {
-	ACharacter* Character = Cast<ACharacter>(OtherActor);
-	if (CheckIsLocalCharacter(Character))
+	StateMachine->TryChangeState(GameplayTags::Portal::Active);
+	if (GetLinkPortal())
+	{
+		GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::LinkActive);
+	}
+}
+
+void APortalDoor::LeaveActivation()
+{
+	StateMachine->TryChangeState(GameplayTags::Portal::UnActive);
+	if (GetLinkPortal())
+	{
+		GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::UnActive);
+	}
+}
+
+void APortalDoor::EnterCrossing()
+{
+	StateMachine->TryChangeState(GameplayTags::Portal::Crossing);
+	if (GetLinkPortal())
+	{
+		GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::LinkCrossing);
+	}
+}
+
+void APortalDoor::LeaveCrossing(const bool bCrossed)
+{
+	if (bCrossed)
+	{
+		StateMachine->TryChangeState(GameplayTags::Portal::PostCrossing);
+		if (GetLinkPortal())
+		{
+			GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::LinkPostCrossing);
+		}
+	}
+	else
 	{
 		StateMachine->TryChangeState(GameplayTags::Portal::Active);
 		if (GetLinkPortal())
@@ -242,17 +1409,57 @@ void APortalDoor::OnActivateBoxOverlapBegin(UPrimitiveComponent* OverlappedCompo
 	}
 }
 
+void APortalDoor::UpdatePlayerZones(const bool bInActivation, const bool bInCrossing, const int32 PlaneCrossing)
+{
+	// A pass through the Plane went through both zones, even if the player skipped over them within the tick
+	const bool bPassedCrossing = bInCrossing || PlaneCrossing != 0;
+	if (!bPlayerInActivation && (bInActivation || bPassedCrossing))
+	{
+		bPlayerInActivation = true;
+		EnterActivation();
+	}
+	if (!bPlayerInCrossing && bPassedCrossing)
+	{
+		bPlayerInCrossing = true;
+		EnterCrossing();
+	}
+
+	if (PlaneCrossing != 0)
+	{
+		bPlayerCrossedPlane = PlaneCrossing > 0;
+	}
+
+	if (bPlayerInCrossing && !bInCrossing)
+	{
+		bPlayerInCrossing = false;
+		const bool bCrossed = bPlayerCrossedPlane;
+		bPlayerCrossedPlane = false;
+		LeaveCrossing(bCrossed);
+	}
+	if (bPlayerInActivation && !bInActivation)
+	{
+		bPlayerInActivation = false;
+		LeaveActivation();
+	}
+}
+
+void APortalDoor::OnActivateBoxOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
+                                            UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	ACharacter* Character = Cast<ACharacter>(OtherActor);
+	if (CheckIsLocalCharacter(Character))
+	{
+		EnterActivation();
+	}
+}
+
 void APortalDoor::OnActivateBoxOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 	UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
 {
 	ACharacter* Character = Cast<ACharacter>(OtherActor);
 	if (CheckIsLocalCharacter(Character))
 	{
-		StateMachine->TryChangeState(GameplayTags::Portal::UnActive);
-		if (GetLinkPortal())
-		{
-			GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::UnActive);
-		}
+		LeaveActivation();
 	}
 }
 
@@ -262,11 +1469,7 @@ void APortalDoor::OnCrossBoxOverlapBegin(UPrimitiveComponent* OverlappedComponen
 	ACharacter* Character = Cast<ACharacter>(OtherActor);
 	if (CheckIsLocalCharacter(Character))
 	{
-		StateMachine->TryChangeState(GameplayTags::Portal::Crossing);
-		if (GetLinkPortal())
-		{
-			GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::LinkCrossing);
-		}
+		EnterCrossing();
 	}
 }
 
@@ -278,30 +1481,14 @@ void APortalDoor::OnCrossBoxOverlapEnd(UPrimitiveComponent* OverlappedComponent,
 	{
 		FVector CharacterLocation = Character->GetActorLocation();
 		float Dot = FVector::DotProduct(CharacterLocation - GetActorLocation(), GetDoorForwardDirection());
-		if (Dot < 0)
-		{
-			StateMachine->TryChangeState(GameplayTags::Portal::PostCrossing);
-			if (GetLinkPortal())
-			{
-				GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::LinkPostCrossing);
-			}
-		}
-		else
-		{
-			StateMachine->TryChangeState(GameplayTags::Portal::Active);
-			if (GetLinkPortal())
-			{
-				GetLinkPortal()->StateMachine->TryChangeState(GameplayTags::Portal::LinkActive);
-			}
-		}
+		LeaveCrossing(Dot < 0);
 	}
 }
 
 void APortalDoor::TeleportCharacter(ACharacter* Character)
 {
-	FTransform CharacterTransform = Character->GetActorTransform();
-	FTransform  FMirroredLocalTrans = CalculateMirroredRelativeTrans(CharacterTransform,GetActorTransform());
-	if (!GetLinkPortal())
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor)
 	{
 		return;
 	}
@@ -311,7 +1498,7 @@ void APortalDoor::TeleportCharacter(ACharacter* Character)
 	const FVector UpVector = GetActorUpVector();
 	
 	// Teleport
-	FTransform FinalTransform = FMirroredLocalTrans * GetLinkPortal()->GetTransform();
+	FTransform FinalTransform = LinkDoor->GetThroughTransform().TransformTransform(Character->GetActorTransform());
 	auto PCharacter =  Cast<APortalCharacter>(Character);
 	if (!PCharacter)
 	{
@@ -333,6 +1520,11 @@ void APortalDoor::TeleportCharacter(ACharacter* Character)
 	FVector FinalControlDir = (LocalControllerVec.Rotation()).RotateVector(NewCharacterDir);
 	ControllerRot.Yaw = FinalControlDir.Rotation().Yaw;
 	PlayerController->SetControlRotation(ControllerRot);
+
+	if (UPortalSpringArmComponent* PortalBoom = Cast<UPortalSpringArmComponent>(PCharacter->GetCameraBoom()))
+	{
+		PortalBoom->OnOwnerTeleported(LinkDoor->GetThroughTransform());
+	}
 	
 	// Velocity
 	FVector FinalVelocityDir = (LocalVelocityVec.Rotation()).RotateVector(NewCharacterDir);
@@ -340,6 +1532,47 @@ void APortalDoor::TeleportCharacter(ACharacter* Character)
 	
 }
 
+void APortalDoor::TeleportActor(AActor* Actor)
+{
+	APortalDoor* LinkDoor = GetLinkPortal();
+	if (!LinkDoor || !Actor)
+	{
+		return;
+	}
+
+	const FPortalThroughTransform& Through = LinkDoor->GetThroughTransform();
+	UPrimitiveComponent* RootPrimitive = Cast<UPrimitiveComponent>(Actor->GetRootComponent());
+	const bool bSimulatingPhysics = RootPrimitive && RootPrimitive->IsSimulatingPhysics();
+	const FVector LinearVelocity = bSimulatingPhysics ? RootPrimitive->GetPhysicsLinearVelocity() : FVector::ZeroVector;
+	const FVector AngularVelocity = bSimulatingPhysics ? RootPrimitive->GetPhysicsAngularVelocityInRadians() : FVector::ZeroVector;
+
+	Actor->SetActorTransform(Through.TransformTransform(Actor->GetActorTransform()), false, nullptr, ETeleportType::TeleportPhysics);
+	if (UPortalSpringArmComponent* PortalBoom = Actor->FindComponentByClass<UPortalSpringArmComponent>())
+	{
+		PortalBoom->OnOwnerTeleported(Through);
+	}
+
+	if (bSimulatingPhysics)
+	{
+		RootPrimitive->SetPhysicsLinearVelocity(Through.TransformDirection(LinearVelocity));
+		RootPrimitive->SetPhysicsAngularVelocityInRadians(Through.TransformDirection(AngularVelocity));
+	}
+	else if (UMovementComponent* Movement = Actor->FindComponentByClass<UMovementComponent>())
+	{
+		Movement->Velocity = Through.TransformDirection(Movement->Velocity);
+		Movement->UpdateComponentVelocity();
+	}
+
+	if (const APawn* Pawn = Cast<APawn>(Actor))
+	{
+		if (AController* Controller = Pawn->GetController())
+		{
+			const FQuat ControlRotation = Through.GetTransform().GetRotation() * Controller->GetControlRotation().Quaternion();
+			Controller->SetControlRotation(ControlRotation.Rotator());
+		}
+	}
+}
+
 void APortalDoor::DetachViewTarget(const bool bDetach)
 {
 	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(this,0);
@@ -361,18 +1594,16 @@ void APortalDoor::DetachViewTarget(const bool bDetach)
 
 void APortalDoor::OnViewportResized(FViewport* Viewport, uint32 NewSize)
 {
-	if(!RTPortal)
+	// The ladder follows the viewport size, prewarm the new one before it is needed
+	PrewarmRenderTargets();
+	if(!RTPortal || !bRenderTargetActive)
 	{
 		return;
 	}
-	
-	// 解析宽度和高度
-	const uint32 Width = Viewport->GetSizeXY().X;
-	const uint32 Height = Viewport->GetSizeXY().Y;
-	if(Width != RTPortal->SizeX || Height != RTPortal->SizeY)
-	{
-		RTPortal->ResizeTarget(Width,Height);
-	}
+
+	const int32 Level = RenderTargetLevel;
+	SetRenderTargetLevel(INDEX_NONE);
+	SetRenderTargetLevel(Level);
 }
 
 bool APortalDoor::CheckIsLocalCharacter(const ACharacter* Character) const
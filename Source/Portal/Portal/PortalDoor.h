@@ -3,14 +3,149 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "WorldCollision.h"
+#include "Engine/Scene.h"
 #include "GameFramework/Actor.h"
+#include "PortalThroughTransform.h"
 #include "PortalDoor.generated.h"
 
 class APortalCharacter;
+class APortalMirrorProxy;
 class UStateMachineComponent;
 class UCameraComponent;
 class UBoxComponent;
 class UMaterialInterface;
+class UMaterialInstanceDynamic;
+
+/** Where the portal Plane lands in the player view, in viewport pixels. */
+struct FPortalScreenFootprint
+{
+	FBox2D ScreenRect{ForceInit};
+
+	FIntRect ViewRect{};
+
+	/** Projection of the player view the footprint was computed with */
+	FMatrix ProjectionMatrix{FMatrix::Identity};
+
+	/** Fraction of the view rect covered by ScreenRect */
+	float Coverage{0.0f};
+
+	bool bOnScreen{false};
+
+	/** Plane bounds intersect the player view frustum */
+	bool bInFrustum{false};
+
+	/** bInFrustum of the previous frame */
+	bool bWasInFrustum{false};
+
+	/** Plane bounds straddle the view plane, treated as covering the whole view */
+	bool bFullScreen{false};
+};
+
+/** Views of a door placed by UPortalSubsystem's batched view pass, chosen by its current state. */
+enum class EPortalViewUpdate : uint8
+{
+	None = 0,
+	/** PortalCamera follows the player camera, then projection, render target and capture are updated */
+	PortalCamera = 1 << 0,
+	/** ViewCamera follows the player's follow camera, used as view target after a crossing */
+	ViewCamera = 1 << 1,
+	/** MirrorProxy follows the player mesh */
+	MirrorProxy = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EPortalViewUpdate)
+
+UENUM()
+enum class EPortalProjectionMode : uint8
+{
+	/** Capture the full player frustum, MI_PortalPlane samples it in screen space */
+	FullView,
+	/**
+	 * FullView with the near plane moved onto the door, so nothing between the PortalCamera and the door is drawn.
+	 * Breaks scene depth reconstruction for fog and screen traces
+	 */
+	Oblique,
+};
+
+UENUM()
+enum class EPortalIdleMode : uint8
+{
+	/** The Plane shows MI_PortalPlane's inactive look */
+	Blank,
+	/**
+	 * The Plane shows snapshots of the link view, captured once and drawn with parallax by MI_PortalPlane.
+	 * Needs a Plane material with the Snapshot, SnapshotTexture and SnapshotViewDirection parameters, without them
+	 * the door stays Blank.
+	 */
+	Snapshot,
+};
+
+/** Expensive features of the main view a portal capture keeps. */
+USTRUCT(BlueprintType)
+struct FPortalCaptureFeatures
+{
+	GENERATED_BODY()
+
+	/** Lumen GI and reflections, otherwise no dynamic GI and screen space reflections */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bLumen{true};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bMotionBlur{true};
+
+	/** Otherwise the capture keeps a fixed exposure */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bAutoExposure{true};
+};
+
+/**
+ * Capture quality tier of a door, picked by APortalDoor::UpdateCaptureLOD.
+ * A tier is used when the player camera is within MaxDistance of the Plane or the Plane covers at least MinCoverage of the view.
+ * The current tier is kept within a margin of both, see r.Portal.CaptureLOD.Hysteresis.
+ */
+USTRUCT(BlueprintType)
+struct FPortalCaptureLOD
+{
+	GENERATED_BODY()
+
+	/** 0 for any distance */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal", meta = (ClampMin = "0"))
+	float MaxDistance{0.0f};
+
+	/** Fraction of the view rect, 0 to ignore coverage */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal", meta = (ClampMin = "0", ClampMax = "1"))
+	float MinCoverage{0.0f};
+
+	/** Applied to the adaptive RTPortal size (r.Portal.AdaptiveResolution) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal", meta = (ClampMin = "0.1", ClampMax = "1"))
+	float ResolutionScale{1.0f};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bDynamicShadows{true};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bAmbientOcclusion{true};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bVolumetricFog{true};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bBloom{true};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	TEnumAsByte<EDynamicGlobalIlluminationMethod::Type> DynamicGlobalIlluminationMethod{EDynamicGlobalIlluminationMethod::Lumen};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	TEnumAsByte<EReflectionMethod::Type> ReflectionMethod{EReflectionMethod::Lumen};
+
+	/** Scales the distance used for mesh LOD selection of the capture view */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal", meta = (ClampMin = "0.1"))
+	float LODDistanceFactor{1.0f};
+
+	/** Primitives farther than this aren't captured, 0 or less to capture everything */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	float MaxViewDistanceOverride{-1.0f};
+};
 
 UCLASS()
 class PORTAL_API APortalDoor : public AActor
@@ -26,23 +161,118 @@ protected:
 	
 	virtual void BeginPlay() override;
 
-	static FTransform CalculateMirroredRelativeTrans(const FTransform& InTransform, const FTransform& BaseTransform);
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	static FMatrix MakeObliqueProjection(const FMatrix& Projection, const FMatrix& ViewMatrix, const FPlane& ClipPlane);
+
+	/** Scene capture view matrix for a camera at the given world transform. */
+	static FMatrix MakeCaptureViewMatrix(const FTransform& ViewTransform);
+
+	/** Narrows Projection to the given UV rectangle of its view. */
+	static FMatrix MakeCropProjection(const FMatrix& Projection, const FVector2D& UVMin, const FVector2D& UVSize);
 
 public:
 
+	/** Maps the link door's side onto this door's side, rebuilt after either door moved. */
+	const FPortalThroughTransform& GetThroughTransform();
+
 	void InitTextureTarget();
 	void SetRenderTargetActive(bool InActive);
+
+	/** Makes the door's target of the given resolution level RTPortal, INDEX_NONE returns all its targets to the pool. */
+	void SetRenderTargetLevel(int32 Level);
+
+	/** Viewport sized target halved Level times, within MinRenderTargetSize and MaxRenderTargetSize */
+	FIntPoint GetRenderTargetLevelSize(int32 Level) const;
+	static int32 GetNumRenderTargetLevels();
+
+	/** Creates the level targets in the pool up front, so activating or switching levels doesn't allocate. */
+	void PrewarmRenderTargets() const;
+
+	/** Projection, render target sizing and capture, run by UPortalSubsystem after it placed PortalCamera. */
+	void UpdatePortalRendering();
+
+	/** Hands the door to UPortalSubsystem's batched view pass, None takes it out. */
+	void SetViewUpdate(EPortalViewUpdate InViewUpdate);
+	EPortalViewUpdate GetViewUpdate() const { return ViewUpdate; }
 	
 	void UpdatePortalCameraTransform();
+	void UpdatePortalProjection();
+	void UpdateRenderTargetResolution();
+
+	/** Renders PortalCamera into the link door's target, unless the link plane can't be seen. */
+	void UpdatePortalCapture();
+
+	/** Captures the link Plane as seen through itself, deepest level first, within the frame budget. */
+	void UpdateRecursiveCaptures(APortalDoor* LinkDoor);
+	bool IsLinkPlaneInCaptureView(const APortalDoor* LinkDoor, const FTransform& ViewTransform, const FMatrix& Projection) const;
+	void ReleaseRecursionTargets(int32 NumToKeep = 0);
+
+	/** Far doors and doors whose capture only changes because of moving primitives render every r.Portal.Throttle.Interval frames. */
+	bool IsCaptureThrottled(const APortalDoor* LinkDoor, bool bViewChanged) const;
+
+	/** Hash of the registered capture movers PortalCamera would see from the given view. */
+	uint32 HashCaptureScene(const FTransform& ViewTransform, const FMatrix& Projection) const;
+
+	/** Texture sampled by the Plane material */
+	void SetPortalTexture(UTexture* Texture);
+
+	EPortalProjectionMode GetProjectionMode() const { return ProjectionMode; }
+
+	/** Main renderer mode and features of the link PortalCamera drawing into RTPortal */
+	void ApplyCaptureSettings(USceneCaptureComponent2D* Capture) const;
+
+	bool IsCaptureInMainView() const { return bCaptureInMainView; }
+
+	/** Renders the idle snapshots of this door's Plane with the link PortalCamera, keeping its live capture state. */
+	void CaptureSnapshots();
+
+	/** Snapshots are recaptured on the next tick while the door is idle, otherwise the next time it goes idle */
+	void InvalidateSnapshots();
+
+	/** IdleMode, Blank unless the Plane material can show snapshots */
+	EPortalIdleMode GetIdleMode() const;
+
+	/** Picks the snapshot taken closest to the player's view direction. */
+	void UpdateSnapshotView();
+
+	/** Picks the CaptureLODs tier for the current player view and applies it to the link PortalCamera when it changed. */
+	void UpdateCaptureLOD();
+	int32 GetCaptureLOD() const { return CaptureLOD; }
+
+	/** Whether Start to End passes the Plane rectangle from the front, OutTime being the fraction along the segment. */
+	bool IntersectPlaneSegment(const FVector& Start, const FVector& End, double& OutTime) const;
+
+	/** Frustum and previous-frame occlusion test of the Plane against the player view. */
+	bool IsPlaneVisible();
+
+	/** Projects the Plane bounds into the player view. Computed once per frame. */
+	const FPortalScreenFootprint& GetScreenFootprint();
+
+	/** Linear size of the view RTPortal is rendered at, following the Plane's screen coverage. 0 keeps the current level. */
+	double GetRenderTargetFraction();
+	static double GetRenderTargetFractionForCoverage(float Coverage);
+	static int32 GetRenderTargetLevelForFraction(double Fraction);
 	void UpdateMirrorCharacterTrans();
 	void UpdateViewCameraTransform();
 	
 	UFUNCTION(Blueprintable)
-	APortalDoor* GetLinkPortal();
+	APortalDoor* GetLinkPortal() const { return LinkPortal.Get(); }
+
+	/** Called by UPortalSubsystem when the link door registers or goes away. */
+	void OnLinkPortalChanged(APortalDoor* NewLinkPortal);
+
+	void OnRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
 
 	UFUNCTION(BlueprintCallable)
 	FVector GetDoorForwardDirection() const {return GetActorForwardVector();}
 	
+	/**
+	 * Player zone update from UPortalTraversalSubsystem, replacing the box overlap events with r.Portal.SweptCrossing.
+	 * PlaneCrossing is 1 if the player's movement passed the Plane from the front this tick, -1 from the back.
+	 */
+	void UpdatePlayerZones(bool bInActivation, bool bInCrossing, int32 PlaneCrossing);
+
 	UFUNCTION(BlueprintCallable)
 	void OnActivateBoxOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 
@@ -58,7 +288,15 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void TeleportCharacter(ACharacter* Character);
 
-	void CreateMirrorCharacter();
+	/** Moves any actor to the link door, carrying over physics or movement component velocity and control rotation. */
+	UFUNCTION(BlueprintCallable)
+	void TeleportActor(AActor* Actor);
+
+	/** Borrows a mirror proxy from UPortalMirrorPool, given back when the door goes UnActive. */
+	void AcquireMirrorProxy();
+	void ReleaseMirrorProxy();
+
+	TSubclassOf<APortalMirrorProxy> GetMirrorProxyClass() const { return MirrorProxyClass; }
 	
 	void DetachViewTarget(bool bDetach);
 	
@@ -93,8 +331,128 @@ public:
 	UCameraComponent* GetLinkPlayerCamera();
 
 protected:
-	UPROPERTY(EditDefaultsOnly,BlueprintReadWrite)
-	TSubclassOf<ACharacter> MirrorCharacterClass;
+	UPROPERTY(EditDefaultsOnly,BlueprintReadWrite,Category = "Portal | Mirror")
+	TSubclassOf<APortalMirrorProxy> MirrorProxyClass;
+
+	/** Smallest long side of RTPortal in adaptive resolution mode (r.Portal.AdaptiveResolution). */
+	UPROPERTY(EditAnywhere,Category = "Portal | Render",meta = (ClampMin = "16"))
+	int32 MinRenderTargetSize{256};
+
+	/** Largest long side of RTPortal in adaptive resolution mode (r.Portal.AdaptiveResolution). */
+	UPROPERTY(EditAnywhere,Category = "Portal | Render",meta = (ClampMin = "16"))
+	int32 MaxRenderTargetSize{4096};
+
+	/** How the link door's PortalCamera frames the image shown on this door's Plane. */
+	UPROPERTY(EditAnywhere,Category = "Portal | Render")
+	EPortalProjectionMode ProjectionMode{EPortalProjectionMode::FullView};
+
+	/**
+	 * Render the link PortalCamera as an extra view of the main view family, sharing shadow depths,
+	 * GPU scene and Lumen scene updates with the main view. No recursion.
+	 */
+	UPROPERTY(EditAnywhere,Category = "Portal | Render")
+	bool bCaptureInMainView{false};
+
+	/** Features the link PortalCamera keeps for this door's image */
+	UPROPERTY(EditAnywhere,Category = "Portal | Render")
+	FPortalCaptureFeatures CaptureFeatures{};
+
+	/** What the Plane shows while the player is outside the activation range */
+	UPROPERTY(EditAnywhere,Category = "Portal | Snapshot")
+	EPortalIdleMode IdleMode{EPortalIdleMode::Blank};
+
+	/** Snapshots spread over SnapshotMaxAngle to both sides of the door, the closest to the player view is shown */
+	UPROPERTY(EditAnywhere,Category = "Portal | Snapshot",meta = (ClampMin = "1", ClampMax = "8"))
+	int32 NumSnapshotViews{1};
+
+	UPROPERTY(EditAnywhere,Category = "Portal | Snapshot",meta = (ClampMin = "0", ClampMax = "80"))
+	float SnapshotMaxAngle{45.0f};
+
+	/** Distance from the Plane the snapshots are taken from */
+	UPROPERTY(EditAnywhere,Category = "Portal | Snapshot",meta = (ClampMin = "1"))
+	float SnapshotDistance{500.0f};
+
+	/** Size of the mipped LDR snapshot targets */
+	UPROPERTY(EditAnywhere,Category = "Portal | Snapshot",meta = (ClampMin = "16", ClampMax = "2048"))
+	int32 SnapshotSize{512};
+
+	/** Capture quality tiers, nearest first. Without a matching tier the last one is used, without tiers the PortalCamera settings as authored. */
+	UPROPERTY(EditAnywhere,Category = "Portal | Render")
+	TArray<FPortalCaptureLOD> CaptureLODs;
+
+private:
+	friend class UPortalTraversalSubsystem;
+
+	/** Slot in UPortalTraversalSubsystem's door arrays */
+	int32 TraversalIndex{INDEX_NONE};
+
+	FPortalScreenFootprint ScreenFootprint{};
+	uint64 ScreenFootprintFrame{MAX_uint64};
+	bool bRenderTargetActive{false};
+
+	/** The Plane material reads the snapshot parameters */
+	bool bPlaneShowsSnapshots{false};
+	EPortalViewUpdate ViewUpdate{EPortalViewUpdate::None};
+
+	FPortalThroughTransform ThroughTransform{};
+	bool bThroughTransformValid{false};
+
+	void EnterActivation();
+	void LeaveActivation();
+	void EnterCrossing();
+	void LeaveCrossing(bool bCrossed);
+
+	/** Player zones last reported to UpdatePlayerZones */
+	bool bPlayerInActivation{false};
+	bool bPlayerInCrossing{false};
+	bool bPlayerCrossedPlane{false};
+
+	/** PortalCamera projection before the oblique near plane is applied */
+	FMatrix PortalCameraProjection{FMatrix::Identity};
+
+	/** Pooled targets of recursion levels 2..N, rendered by PortalCamera and shown on the link Plane */
+	UPROPERTY(Transient)
+	TArray<UTextureRenderTarget2D*> RecursionTargets;
+
+
+	/** State of the last PortalCamera capture, for dirty tracking and throttling */
+	FTransform LastCaptureTransform{};
+	FMatrix LastCaptureProjection{FMatrix::Identity};
+	TWeakObjectPtr<UTextureRenderTarget2D> LastCaptureTarget{nullptr};
+	uint32 LastCaptureSceneHash{0};
+	uint64 LastCaptureFrame{0};
+
+	/** Shows or hides the idle snapshot on the Plane, capturing it first if needed */
+	void SetSnapshotActive(bool bInActive);
+
+	/** Deferred part of InvalidateSnapshots, once for all the invalidations of a frame */
+	void RecaptureSnapshots();
+
+	/** Returns the snapshot targets to UPortalRenderTargetPool */
+	void ReleaseSnapshotTargets();
+
+	/** Pooled LDR targets with mips, one per snapshot view */
+	UPROPERTY(Transient)
+	TArray<UTextureRenderTarget2D*> SnapshotTargets;
+
+	/** View direction of every snapshot, door space */
+	TArray<FVector> SnapshotDirections;
+
+	bool bSnapshotsValid{false};
+	bool bSnapshotActive{false};
+	bool bSnapshotRecapturePending{false};
+	int32 SnapshotView{INDEX_NONE};
+	FTimerHandle SnapshotTimer;
+
+	/** Pooled targets of the resolution levels used since activation, indexed by level */
+	UPROPERTY(Transient)
+	TArray<UTextureRenderTarget2D*> LevelTargets;
+
+	int32 RenderTargetLevel{INDEX_NONE};
+
+	/** Index into CaptureLODs applied to the link PortalCamera */
+	int32 CaptureLOD{INDEX_NONE};
+
 public:
 	UPROPERTY()
 	TWeakObjectPtr<APortalDoor> LinkPortal{nullptr};
@@ -109,17 +467,18 @@ public:
 	UTextureRenderTarget2D* RTPortal{nullptr};
 
 	UPROPERTY(BlueprintReadOnly,Transient)
-	ACharacter* MirrorCharacter{nullptr};
+	APortalMirrorProxy* MirrorProxy{nullptr};
 
 	UPROPERTY(EditDefaultsOnly,BlueprintReadWrite)
 	UStateMachineComponent* StateMachine{nullptr};
 
 	UPROPERTY()
 	bool bDetachCamera{false};
+
+	/** Camera to character trace of UPortalLinkPostCrossingState, requested one frame and read the next */
+	FTraceHandle PostCrossingTrace{};
 	
 	void OnViewportResized(FViewport* Viewport, uint32 NewSize);
 	
 	bool CheckIsLocalCharacter(const ACharacter* Character) const;
-	
-	TArray<TWeakObjectPtr<ACharacter>> PrepareTeleportCharacter;
 };
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalMirrorPool.h"
+
+#include "PortalDoor.h"
+#include "PortalMirrorProxy.h"
+#include "PortalSubsystem.h"
+#include "GameFramework/Character.h"
+#include "Kismet/GameplayStatics.h"
+
+static TAutoConsoleVariable<int32> CVarPortalMirrorPoolSize(
+	TEXT("r.Portal.MirrorPool.Size"),
+	-1,
+	TEXT("Mirror proxies spawned per proxy class when the level starts.\n")
+	TEXT("-1: one for every linked portal pair using that class."),
+	ECVF_Default);
+
+bool UPortalMirrorPool::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPortalMirrorPool::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Count linked pairs per proxy class, only one door of a pair is LinkActive at a time
+	TMap<UClass*, int32> PoolSizes;
+	if (const UPortalSubsystem* PortalSubsystem = InWorld.GetSubsystem<UPortalSubsystem>())
+	{
+		for (const TPair<FName, TWeakObjectPtr<APortalDoor>>& Portal : PortalSubsystem->GetPortals())
+		{
+			const APortalDoor* Door = Portal.Value.Get();
+			const APortalDoor* LinkDoor = Door ? Door->GetLinkPortal() : nullptr;
+			if (!LinkDoor || !Door->GetMirrorProxyClass())
+			{
+				continue;
+			}
+
+			// Once per pair, or once per door if the two doors use different classes
+			if (Door->GetMirrorProxyClass() != LinkDoor->GetMirrorProxyClass() || Door->PortalTag.LexicalLess(LinkDoor->PortalTag))
+			{
+				++PoolSizes.FindOrAdd(Door->GetMirrorProxyClass());
+			}
+		}
+	}
+
+	const int32 ConfigSize = CVarPortalMirrorPoolSize.GetValueOnGameThread();
+	if (ConfigSize >= 0)
+	{
+		for (TPair<UClass*, int32>& PoolSize : PoolSizes)
+		{
+			PoolSize.Value = ConfigSize;
+		}
+	}
+
+	// The player is possessed before BeginPlay, so the proxies can be bound and warmed up right away
+	ACharacter* Character = UGameplayStatics::GetPlayerCharacter(&InWorld,0);
+	USkeletalMeshComponent* SourceMesh = Character ? Character->GetMesh() : nullptr;
+	for (const TPair<UClass*, int32>& PoolSize : PoolSizes)
+	{
+		TArray<APortalMirrorProxy*>& Free = FreeMirrorProxies.FindOrAdd(PoolSize.Key);
+		Free.Reserve(PoolSize.Value);
+		for (int32 Index = 0; Index < PoolSize.Value; ++Index)
+		{
+			if (APortalMirrorProxy* MirrorProxy = SpawnMirrorProxy(PoolSize.Key, SourceMesh))
+			{
+				MirrorProxy->WarmUp();
+				MirrorProxy->SetSourceMesh(nullptr);
+				Free.Add(MirrorProxy);
+			}
+		}
+	}
+}
+
+void UPortalMirrorPool::Deinitialize()
+{
+	FreeMirrorProxies.Empty();
+	MirrorProxies.Empty();
+
+	Super::Deinitialize();
+}
+
+APortalMirrorProxy* UPortalMirrorPool::AcquireMirrorProxy(const TSubclassOf<APortalMirrorProxy> ProxyClass, USkeletalMeshComponent* SourceMesh)
+{
+	if (!ProxyClass)
+	{
+		return nullptr;
+	}
+
+	APortalMirrorProxy* MirrorProxy = nullptr;
+	TArray<APortalMirrorProxy*>* Free = FreeMirrorProxies.Find(ProxyClass.Get());
+	if (Free && Free->Num() > 0)
+	{
+		MirrorProxy = Free->Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Log, TEXT("Mirror pool of %s is empty, spawning a proxy during play."), *ProxyClass->GetName());
+		MirrorProxy = SpawnMirrorProxy(ProxyClass, SourceMesh);
+	}
+
+	if (MirrorProxy)
+	{
+		// Free proxies are unbound, the mesh asset is only replaced if the player pawn changed
+		MirrorProxy->SetSourceMesh(SourceMesh);
+	}
+	return MirrorProxy;
+}
+
+void UPortalMirrorPool::ReleaseMirrorProxy(APortalMirrorProxy* MirrorProxy)
+{
+	if (!MirrorProxy || !ensure(MirrorProxies.Contains(MirrorProxy)))
+	{
+		return;
+	}
+
+	MirrorProxy->SetActorHiddenInGame(true);
+	MirrorProxy->SetSourceMesh(nullptr);
+	FreeMirrorProxies.FindChecked(MirrorProxy->GetClass()).Add(MirrorProxy);
+}
+
+APortalMirrorProxy* UPortalMirrorPool::SpawnMirrorProxy(const TSubclassOf<APortalMirrorProxy> ProxyClass, USkeletalMeshComponent* SourceMesh)
+{
+	FActorSpawnParameters ActorSpawnParams;
+	ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	APortalMirrorProxy* MirrorProxy = GetWorld()->SpawnActor<APortalMirrorProxy>(ProxyClass, FTransform::Identity, ActorSpawnParams);
+	if (!MirrorProxy)
+	{
+		return nullptr;
+	}
+
+	MirrorProxy->SetSourceMesh(SourceMesh);
+	MirrorProxy->SetActorHiddenInGame(true);
+	MirrorProxies.Add(MirrorProxy);
+
+	// No collision, so only visible to dirty tracking as a registered mover
+	if (UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>())
+	{
+		PortalSubsystem->RegisterCaptureMover(MirrorProxy);
+	}
+
+	// Keep release allocation free for proxies spawned late as well
+	TArray<APortalMirrorProxy*>& Free = FreeMirrorProxies.FindOrAdd(ProxyClass.Get());
+	Free.Reserve(MirrorProxies.Num());
+	return MirrorProxy;
+}
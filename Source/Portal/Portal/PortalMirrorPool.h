@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalMirrorPool.generated.h"
+
+class APortalMirrorProxy;
+
+/**
+ * Mirror proxies spawned and warmed up when the level starts, lent to doors entering LinkActive.
+ * Acquire and release only move pointers between preallocated arrays and bind or unbind the source mesh,
+ * so free proxies do no pose work.
+ */
+UCLASS()
+class PORTAL_API UPortalMirrorPool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	/** A hidden proxy of the given class following SourceMesh, spawned only if the pool ran dry. */
+	APortalMirrorProxy* AcquireMirrorProxy(TSubclassOf<APortalMirrorProxy> ProxyClass, USkeletalMeshComponent* SourceMesh);
+
+	void ReleaseMirrorProxy(APortalMirrorProxy* MirrorProxy);
+
+protected:
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+
+	APortalMirrorProxy* SpawnMirrorProxy(TSubclassOf<APortalMirrorProxy> ProxyClass, USkeletalMeshComponent* SourceMesh);
+
+	/** Every proxy owned by the pool, lent out or free */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<APortalMirrorProxy>> MirrorProxies;
+
+	/** Free proxies per class, reserved for all proxies of that class */
+	TMap<UClass*, TArray<APortalMirrorProxy*>> FreeMirrorProxies;
+};
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalMirrorProxy.h"
+
+#include "MirrorAnimInstance.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+
+APortalMirrorProxy::APortalMirrorProxy()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	Mesh = CreateDefaultSubobject<USkeletalMeshComponent>("Mesh");
+	RootComponent = Mesh;
+	Mesh->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+	Mesh->SetGenerateOverlapEvents(false);
+	Mesh->SetCanEverAffectNavigation(false);
+	Mesh->KinematicBonesUpdateToPhysics = EKinematicBonesUpdateToPhysics::SkipAllBones;
+
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+}
+
+void APortalMirrorProxy::WarmUp()
+{
+	// Leader pose followers have nothing to evaluate
+	if (Mesh->GetAnimInstance())
+	{
+		Mesh->TickAnimation(0.0f, false);
+		Mesh->RefreshBoneTransforms();
+	}
+}
+
+void APortalMirrorProxy::SetSourceMesh(USkeletalMeshComponent* InSourceMesh)
+{
+	if (SourceMesh.Get() == InSourceMesh)
+	{
+		return;
+	}
+	if (USkeletalMeshComponent* OldSourceMesh = SourceMesh.Get())
+	{
+		Mesh->PrimaryComponentTick.RemovePrerequisite(OldSourceMesh, OldSourceMesh->PrimaryComponentTick);
+	}
+	SourceMesh = InSourceMesh;
+
+	// Unbound proxies sit in the pool, they must not evaluate or copy a pose
+	Mesh->SetComponentTickEnabled(InSourceMesh != nullptr);
+	if (!InSourceMesh)
+	{
+		Mesh->SetLeaderPoseComponent(nullptr);
+		if (UMirrorAnimInstance* MirrorAnimInstance = Cast<UMirrorAnimInstance>(Mesh->GetAnimInstance()))
+		{
+			MirrorAnimInstance->SourceMesh = nullptr;
+		}
+		return;
+	}
+
+	Mesh->SetSkeletalMeshAsset(InSourceMesh->GetSkeletalMeshAsset());
+	for (int32 MaterialIndex = 0; MaterialIndex < InSourceMesh->GetNumMaterials(); ++MaterialIndex)
+	{
+		Mesh->SetMaterial(MaterialIndex, InSourceMesh->GetMaterial(MaterialIndex));
+	}
+
+	// Subclasses with a UMirrorAnimInstance copy the pose on the animation worker threads instead.
+	// It keeps refreshing while hidden and bound, so the pose is current on the first frame the mirror shows.
+	if (UMirrorAnimInstance* MirrorAnimInstance = Cast<UMirrorAnimInstance>(Mesh->GetAnimInstance()))
+	{
+		MirrorAnimInstance->SourceMesh = InSourceMesh;
+		Mesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+		Mesh->PrimaryComponentTick.AddPrerequisite(InSourceMesh, InSourceMesh->PrimaryComponentTick);
+	}
+	else
+	{
+		Mesh->SetLeaderPoseComponent(InSourceMesh);
+	}
+}
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PortalMirrorProxy.generated.h"
+
+/**
+ * Stand-in for the player shown next to the link door while crossing.
+ * Only a skeletal mesh following the player's mesh as leader pose: no movement, collision or actor tick.
+ * Setting a UMirrorAnimInstance as AnimClass switches to copying the pose on the animation worker threads.
+ */
+UCLASS(Blueprintable)
+class PORTAL_API APortalMirrorProxy : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	APortalMirrorProxy();
+
+	/** Takes over the mesh asset and materials of InSourceMesh and follows its pose. */
+	void SetSourceMesh(USkeletalMeshComponent* InSourceMesh);
+
+	USkeletalMeshComponent* GetSourceMesh() const { return SourceMesh.Get(); }
+
+	/** One animation update and bone refresh ahead of time, used while the level loads. */
+	void WarmUp();
+
+	USkeletalMeshComponent* GetMesh() const { return Mesh; }
+
+protected:
+	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = "Portal | Mirror")
+	USkeletalMeshComponent* Mesh{nullptr};
+
+	UPROPERTY(Transient)
+	TWeakObjectPtr<USkeletalMeshComponent> SourceMesh{nullptr};
+};
@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalRenderTargetPool.h"
+
+#include "Engine/TextureRenderTarget2D.h"
+
+static TAutoConsoleVariable<int32> CVarPortalRenderTargetPoolMaxFree(
+	TEXT("r.Portal.RenderTargetPool.MaxFree"),
+	4,
+	TEXT("Number of released portal render targets kept around for reuse."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalRenderTargetPoolPrewarm(
+	TEXT("r.Portal.RenderTargetPool.Prewarm"),
+	2,
+	TEXT("Targets of every adaptive resolution level created when play begins, about the number of doors active at once.\n")
+	TEXT("They are never trimmed, so activating those doors doesn't allocate."),
+	ECVF_Scalability);
+
+bool UPortalRenderTargetPool::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPortalRenderTargetPool::Deinitialize()
+{
+	FreeRenderTargets.Empty();
+	FreeOrder.Empty();
+	RenderTargets.Empty();
+
+	Super::Deinitialize();
+}
+
+UTextureRenderTarget2D* UPortalRenderTargetPool::AcquireRenderTarget(const FIntPoint Size, const ETextureRenderTargetFormat Format, const bool bMips)
+{
+	if (Size.X <= 0 || Size.Y <= 0)
+	{
+		return nullptr;
+	}
+
+	const FPortalRenderTargetKey Key(Size, Format, bMips);
+	if (TArray<UTextureRenderTarget2D*>* Free = FreeRenderTargets.Find(Key))
+	{
+		if (Free->Num() > 0)
+		{
+			UTextureRenderTarget2D* RenderTarget = Free->Pop(EAllowShrinking::No);
+			FreeOrder.RemoveSingle(RenderTarget);
+			return RenderTarget;
+		}
+	}
+
+	return CreateRenderTarget(Key);
+}
+
+UTextureRenderTarget2D* UPortalRenderTargetPool::CreateRenderTarget(const FPortalRenderTargetKey& Key)
+{
+	UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(this);
+	RenderTarget->RenderTargetFormat = Key.Format;
+	RenderTarget->bAutoGenerateMips = Key.bMips;
+	RenderTarget->InitAutoFormat(Key.Size.X, Key.Size.Y);
+	RenderTarget->UpdateResourceImmediate(true);
+	RenderTargets.Add(RenderTarget);
+	return RenderTarget;
+}
+
+void UPortalRenderTargetPool::PrewarmRenderTargets(const FIntPoint ViewportSize, const TConstArrayView<FIntPoint> Sizes)
+{
+	if (ViewportSize != PrewarmViewportSize)
+	{
+		PrewarmSizes.Reset();
+		PrewarmViewportSize = ViewportSize;
+	}
+
+	const int32 Count = FMath::Max(0, CVarPortalRenderTargetPoolPrewarm.GetValueOnGameThread());
+	for (const FIntPoint& Size : Sizes)
+	{
+		bool bAlreadyPrewarmed = false;
+		PrewarmSizes.Add(Size, &bAlreadyPrewarmed);
+		if (bAlreadyPrewarmed || Size.X <= 0 || Size.Y <= 0)
+		{
+			continue;
+		}
+
+		const FPortalRenderTargetKey Key(Size, RTF_RGBA16f, false);
+		int32 NumExisting = 0;
+		for (const UTextureRenderTarget2D* RenderTarget : RenderTargets)
+		{
+			NumExisting += FPortalRenderTargetKey(RenderTarget) == Key;
+		}
+		for (int32 Index = NumExisting; Index < Count; ++Index)
+		{
+			UTextureRenderTarget2D* RenderTarget = CreateRenderTarget(Key);
+			FreeRenderTargets.FindOrAdd(Key).Add(RenderTarget);
+			FreeOrder.Add(RenderTarget);
+		}
+	}
+}
+
+void UPortalRenderTargetPool::ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget)
+{
+	if (!RenderTarget || !ensure(RenderTargets.Contains(RenderTarget)) || FreeOrder.Contains(RenderTarget))
+	{
+		return;
+	}
+
+	FreeRenderTargets.FindOrAdd(FPortalRenderTargetKey(RenderTarget)).Add(RenderTarget);
+	FreeOrder.Add(RenderTarget);
+
+	TrimFreeRenderTargets(FMath::Max(0, CVarPortalRenderTargetPoolMaxFree.GetValueOnGameThread()));
+}
+
+void UPortalRenderTargetPool::TrimFreeRenderTargets(const int32 MaxFree)
+{
+	// Prewarmed sizes keep their count on top of MaxFree
+	const int32 PrewarmCount = FMath::Max(0, CVarPortalRenderTargetPoolPrewarm.GetValueOnGameThread());
+
+	for (int32 Index = 0; Index < FreeOrder.Num() && FreeOrder.Num() > MaxFree; )
+	{
+		UTextureRenderTarget2D* RenderTarget = FreeOrder[Index];
+		const FPortalRenderTargetKey Key(RenderTarget);
+		TArray<UTextureRenderTarget2D*>& Free = FreeRenderTargets.FindChecked(Key);
+		if (Key == FPortalRenderTargetKey(Key.Size, RTF_RGBA16f, false) && PrewarmSizes.Contains(Key.Size) && Free.Num() <= PrewarmCount)
+		{
+			++Index;
+			continue;
+		}
+		FreeOrder.RemoveAt(Index, EAllowShrinking::No);
+
+		Free.RemoveSingle(RenderTarget);
+		if (Free.Num() == 0)
+		{
+			FreeRenderTargets.Remove(Key);
+		}
+
+		RenderTargets.RemoveSingleSwap(RenderTarget);
+		RenderTarget->ReleaseResource();
+	}
+}
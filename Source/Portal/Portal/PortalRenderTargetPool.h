@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalRenderTargetPool.generated.h"
+
+/** What makes two pooled targets interchangeable */
+struct FPortalRenderTargetKey
+{
+	FIntPoint Size{FIntPoint::ZeroValue};
+	ETextureRenderTargetFormat Format{RTF_RGBA16f};
+	bool bMips{false};
+
+	FPortalRenderTargetKey() = default;
+	FPortalRenderTargetKey(FIntPoint InSize, ETextureRenderTargetFormat InFormat, bool bInMips)
+		: Size(InSize), Format(InFormat), bMips(bInMips) {}
+	explicit FPortalRenderTargetKey(const UTextureRenderTarget2D* RenderTarget)
+		: Size(RenderTarget->SizeX, RenderTarget->SizeY), Format(RenderTarget->RenderTargetFormat), bMips(RenderTarget->bAutoGenerateMips) {}
+
+	bool operator==(const FPortalRenderTargetKey& Other) const
+	{
+		return Size == Other.Size && Format == Other.Format && bMips == Other.bMips;
+	}
+
+	friend uint32 GetTypeHash(const FPortalRenderTargetKey& Key)
+	{
+		return HashCombineFast(GetTypeHash(Key.Size), GetTypeHash((uint32(Key.Format) << 1) | uint32(Key.bMips)));
+	}
+};
+
+/**
+ * Render targets for portal captures, handed out to active doors and to idle snapshots.
+ * Released targets are kept per size and format and reused as-is, so toggling a door or
+ * moving between adaptive size buckets does not reallocate GPU memory.
+ */
+UCLASS()
+class PORTAL_API UPortalRenderTargetPool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Live captures use the default HDR format without mips, snapshots ask for LDR with mips. */
+	UTextureRenderTarget2D* AcquireRenderTarget(FIntPoint Size, ETextureRenderTargetFormat Format = RTF_RGBA16f, bool bMips = false);
+
+	void ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget);
+
+	/**
+	 * Creates r.Portal.RenderTargetPool.Prewarm targets of every size up front and keeps them out of trimming.
+	 * Sizes prewarmed for another viewport size are dropped.
+	 */
+	void PrewarmRenderTargets(FIntPoint ViewportSize, TConstArrayView<FIntPoint> Sizes);
+
+	int32 GetNumFreeRenderTargets() const { return FreeOrder.Num(); }
+
+protected:
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+
+	void TrimFreeRenderTargets(int32 MaxFree);
+
+	UTextureRenderTarget2D* CreateRenderTarget(const FPortalRenderTargetKey& Key);
+
+	/** Every target created by the pool, in use or free. */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UTextureRenderTarget2D>> RenderTargets;
+
+	TMap<FPortalRenderTargetKey, TArray<UTextureRenderTarget2D*>> FreeRenderTargets;
+
+	/** Free targets, least recently released first */
+	TArray<UTextureRenderTarget2D*> FreeOrder;
+
+	/** Sizes of default format targets kept at the prewarm count, for PrewarmViewportSize */
+	TSet<FIntPoint> PrewarmSizes;
+	FIntPoint PrewarmViewportSize{FIntPoint::ZeroValue};
+};
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalSpringArmComponent.h"
+
+#include "PortalDoor.h"
+#include "PortalSubsystem.h"
+
+void UPortalSpringArmComponent::OnOwnerTeleported(const FPortalThroughTransform& Through)
+{
+	PreviousArmOrigin = Through.TransformPosition(PreviousArmOrigin);
+	PreviousDesiredLoc = Through.TransformPosition(PreviousDesiredLoc);
+	PreviousDesiredRot = Through.TransformTransform(FTransform(PreviousDesiredRot)).Rotator();
+}
+
+APortalDoor* UPortalSpringArmComponent::FindPortalDoor(const FVector& Start, const FVector& End, double& OutTime) const
+{
+	const UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld());
+	if (!PortalSubsystem)
+	{
+		return nullptr;
+	}
+
+	APortalDoor* FoundDoor = nullptr;
+	OutTime = 1.0;
+	for (const TPair<FName, TWeakObjectPtr<APortalDoor>>& Portal : PortalSubsystem->GetPortals())
+	{
+		APortalDoor* Door = Portal.Value.Get();
+		double Time = 0.0;
+		if (Door && Door->GetLinkPortal() && Door->IntersectPlaneSegment(Start, End, Time) && Time < OutTime)
+		{
+			FoundDoor = Door;
+			OutTime = Time;
+		}
+	}
+	return FoundDoor;
+}
+
+void UPortalSpringArmComponent::UpdateDesiredArmLocation(bool bDoTrace, bool bDoLocationLag, bool bDoRotationLag, float DeltaTime)
+{
+	// Lag and the unobstructed socket transform as usual, the probe is done below
+	Super::UpdateDesiredArmLocation(bTraceThroughPortals ? false : bDoTrace, bDoLocationLag, bDoRotationLag, DeltaTime);
+	PortalDoor = nullptr;
+	if (!bTraceThroughPortals)
+	{
+		return;
+	}
+
+	const FTransform& ComponentTransform = GetComponentTransform();
+	const FTransform DesiredTransform = FTransform(RelativeSocketRotation, RelativeSocketLocation) * ComponentTransform;
+	const FVector ArmOrigin = PreviousArmOrigin;
+	FVector Start = ArmOrigin;
+	FVector End = DesiredTransform.GetLocation();
+	FTransform SocketTransform = DesiredTransform;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PortalSpringArm), false, GetOwner());
+
+	double PortalTime = 1.0;
+	APortalDoor* Door = FindPortalDoor(Start, End, PortalTime);
+	if (Door)
+	{
+		// Only the Planes are passed through, the door frames still block the probe
+		QueryParams.AddIgnoredComponent(Door->Plane);
+		QueryParams.AddIgnoredComponent(Door->GetLinkPortal()->Plane);
+	}
+
+	// Near side up to the Plane, or the whole arm without a portal
+	FHitResult Hit;
+	const FVector PortalPoint = FMath::Lerp(Start, End, PortalTime);
+	const bool bNearHit = bDoTrace
+		&& GetWorld()->SweepSingleByChannel(Hit, Start, PortalPoint, FQuat::Identity, ProbeChannel, FCollisionShape::MakeSphere(ProbeSize), QueryParams);
+
+	FVector SocketLocation = End;
+	bool bHit = bNearHit;
+	if (bNearHit || !Door)
+	{
+		SocketLocation = BlendLocations(End, Hit.Location, bNearHit, DeltaTime);
+	}
+	else
+	{
+		// Rest of the arm continues from the link door
+		const FPortalThroughTransform& Through = Door->GetLinkPortal()->GetThroughTransform();
+		Start = Through.TransformPosition(PortalPoint);
+		End = Through.TransformPosition(End);
+		SocketTransform = Through.TransformTransform(DesiredTransform);
+
+		bHit = bDoTrace
+			&& GetWorld()->SweepSingleByChannel(Hit, Start, End, FQuat::Identity, ProbeChannel, FCollisionShape::MakeSphere(ProbeSize), QueryParams);
+		SocketLocation = BlendLocations(End, Hit.Location, bHit, DeltaTime);
+		PortalDoor = Door;
+	}
+
+	// What the base class probe would have recorded, on whichever side the camera ends up
+	bIsCameraFixed = bHit && !SocketLocation.Equals(End);
+	if (!bIsCameraFixed)
+	{
+		UnfixedCameraPosition = SocketLocation;
+	}
+
+	SocketTransform.SetLocation(SocketLocation);
+	const FTransform RelativeSocketTransform = SocketTransform.GetRelativeTransform(ComponentTransform);
+	RelativeSocketLocation = RelativeSocketTransform.GetLocation();
+	RelativeSocketRotation = RelativeSocketTransform.GetRotation();
+
+	UpdateChildTransforms();
+}
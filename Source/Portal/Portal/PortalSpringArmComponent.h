@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/SpringArmComponent.h"
+#include "PortalSpringArmComponent.generated.h"
+
+class APortalDoor;
+struct FPortalThroughTransform;
+
+/**
+ * Camera boom whose arm continues through portal doors.
+ * When the arm passes a door Plane from the front, the rest of it is mapped to the link door
+ * and the collision probe keeps going on that side, so the camera ends up behind the link door
+ * and sees the character through it. The camera stays attached across a crossing.
+ */
+UCLASS(ClassGroup=(Portal), meta=(BlueprintSpawnableComponent))
+class PORTAL_API UPortalSpringArmComponent : public USpringArmComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Maps the lag state through a teleport of the owner, so the camera doesn't swing across the world. */
+	void OnOwnerTeleported(const FPortalThroughTransform& Through);
+
+	bool IsTracingThroughPortals() const { return bTraceThroughPortals; }
+
+	/** Door the arm currently passes through, if any */
+	APortalDoor* GetPortalDoor() const { return PortalDoor.Get(); }
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	bool bTraceThroughPortals{true};
+
+protected:
+
+	virtual void UpdateDesiredArmLocation(bool bDoTrace, bool bDoLocationLag, bool bDoRotationLag, float DeltaTime) override;
+
+private:
+
+	/** Earliest linked door whose Plane the segment passes from the front */
+	APortalDoor* FindPortalDoor(const FVector& Start, const FVector& End, double& OutTime) const;
+
+	TWeakObjectPtr<APortalDoor> PortalDoor{nullptr};
+};
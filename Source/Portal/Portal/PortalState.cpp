@@ -1,14 +1,22 @@
 ﻿#include "PortalState.h"
 
-#include "MirrorAnimInstance.h"
 #include "PortalCharacter.h"
 #include "PortalDoor.h"
+#include "PortalMirrorProxy.h"
+#include "PortalSpringArmComponent.h"
 #include "Camera/CameraComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "Global/GameTraceChannel.h"
 #include "StateMachine/StateMachineComponent.h"
 #include "Kismet/GameplayStatics.h"
 
+/** The camera boom follows the arm through the door, so the view target never has to move to the door. */
+static bool IsCameraThroughPortal(const APortalCharacter* PCharacter)
+{
+	const UPortalSpringArmComponent* PortalBoom = PCharacter ? Cast<UPortalSpringArmComponent>(PCharacter->GetCameraBoom()) : nullptr;
+	return PortalBoom && PortalBoom->IsTracingThroughPortals();
+}
+
 /*
  * PortalUnActiveState
  */
@@ -18,18 +26,20 @@ UPortalUnActiveState::UPortalUnActiveState()
 	StateTag = GameplayTags::Portal::UnActive;
 }
 
-void UPortalUnActiveState::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UPortalUnActiveState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateEntered_Implementation(FromState);
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
+	Super::OnStateEntered_Implementation(Context, FromState);
+	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
 	ensure(PortalDoor);
 	PortalDoor->SetRenderTargetActive(false);
+	PortalDoor->ReleaseMirrorProxy();
+	PortalDoor->SetViewUpdate(EPortalViewUpdate::None);
 }
 
-void UPortalUnActiveState::OnStateExited_Implementation(const FGameplayTag& ToState)
+void UPortalUnActiveState::OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState)
 {
-	Super::OnStateExited_Implementation(ToState);
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
+	Super::OnStateExited_Implementation(Context, ToState);
+	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
 	PortalDoor->SetRenderTargetActive(true);
 }
 
@@ -42,21 +52,17 @@ UPortalActiveState::UPortalActiveState()
 	StateTag =GameplayTags::Portal::Active;
 }
 
-void UPortalActiveState::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UPortalActiveState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateEntered_Implementation(FromState);
+	Super::OnStateEntered_Implementation(Context, FromState);
 
-	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(this,0);
-	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(Context.Owner,0);
+	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0));
 	PlayerController->SetViewTargetWithBlend(PCharacter,0);
-}
 
-void UPortalActiveState::Update(float DeltaTime)
-{
-	Super::Update(DeltaTime);
-	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get()))
+	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get()))
 	{
-		PortalDoor->UpdatePortalCameraTransform();
+		PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera);
 	}
 }
 
@@ -69,21 +75,13 @@ UPortalLinkActiveState::UPortalLinkActiveState()
 	StateTag = GameplayTags::Portal::LinkActive;
 }
 
-void UPortalLinkActiveState::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UPortalLinkActiveState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateEntered_Implementation(FromState);
-	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get()))
+	Super::OnStateEntered_Implementation(Context, FromState);
+	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get()))
 	{
-		PortalDoor->CreateMirrorCharacter();
-	}
-}
-
-void UPortalLinkActiveState::Update(float DeltaTime)
-{
-	Super::Update(DeltaTime);
-	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get()))
-	{
-		PortalDoor->UpdatePortalCameraTransform();
+		PortalDoor->AcquireMirrorProxy();
+		PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera);
 	}
 }
 
@@ -96,27 +94,30 @@ UPortalCrossingState::UPortalCrossingState()
 	StateTag = GameplayTags::Portal::Crossing;
 }
 
-void UPortalCrossingState::OnStateExited_Implementation(const FGameplayTag& ToState)
+void UPortalCrossingState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateExited_Implementation(ToState);
-
-	if (ToState == GameplayTags::Portal::PostCrossing)
+	Super::OnStateEntered_Implementation(Context, FromState);
+	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get()))
 	{
-		// Detach view target 
-		APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
-		APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
-		
-		PortalDoor->TeleportCharacter(PCharacter);
-		PortalDoor->DetachViewTarget(true);
+		PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera);
 	}
 }
 
-void UPortalCrossingState::Update(float DeltaTime)
+void UPortalCrossingState::OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState)
 {
-	Super::Update(DeltaTime);
-	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get()))
+	Super::OnStateExited_Implementation(Context, ToState);
+
+	if (ToState == GameplayTags::Portal::PostCrossing)
 	{
-		PortalDoor->UpdatePortalCameraTransform();
+		// Detach view target 
+		APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
+		APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0));
+		
+		PortalDoor->TeleportCharacter(PCharacter);
+		if (!IsCameraThroughPortal(PCharacter))
+		{
+			PortalDoor->DetachViewTarget(true);
+		}
 	}
 }
 
@@ -129,31 +130,26 @@ UPortalLinkCrossingState::UPortalLinkCrossingState()
 	StateTag = GameplayTags::Portal::LinkCrossing;
 }
 
-void UPortalLinkCrossingState::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UPortalLinkCrossingState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateEntered_Implementation(FromState);
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
+	Super::OnStateEntered_Implementation(Context, FromState);
+	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
 	ensure(PortalDoor);
-	PortalDoor->MirrorCharacter->GetMesh()->GetAnimInstance()->UpdateAnimation(0,true);
-	PortalDoor->MirrorCharacter->GetMesh()->RefreshBoneTransforms();
-	PortalDoor->MirrorCharacter->SetActorHiddenInGame(false);
+	if (PortalDoor->MirrorProxy)
+	{
+		PortalDoor->MirrorProxy->SetActorHiddenInGame(false);
+	}
+	PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera | EPortalViewUpdate::MirrorProxy);
 }
 
-void UPortalLinkCrossingState::OnStateExited_Implementation(const FGameplayTag& ToState)
+void UPortalLinkCrossingState::OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState)
 {
-	Super::OnStateExited_Implementation(ToState);
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
+	Super::OnStateExited_Implementation(Context, ToState);
+	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
 	ensure(PortalDoor);
-	PortalDoor->MirrorCharacter->SetActorHiddenInGame(true);
-}
-
-void UPortalLinkCrossingState::Update(float DeltaTime)
-{
-	Super::Update(DeltaTime);
-	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get()))
+	if (PortalDoor->MirrorProxy)
 	{
-		PortalDoor->UpdatePortalCameraTransform();
-		PortalDoor->UpdateMirrorCharacterTrans();
+		PortalDoor->MirrorProxy->SetActorHiddenInGame(true);
 	}
 }
 
@@ -165,38 +161,29 @@ UPortalPostCrossingState::UPortalPostCrossingState()
 	StateTag = GameplayTags::Portal::PostCrossing;
 }
 
-void UPortalPostCrossingState::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UPortalPostCrossingState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateEntered_Implementation(FromState);
+	Super::OnStateEntered_Implementation(Context, FromState);
 	
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
+	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
+	if (IsCameraThroughPortal(Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0))))
+	{
+		PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera);
+		return;
+	}
 	PortalDoor->UpdateViewCameraTransform();
+	PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera | EPortalViewUpdate::ViewCamera);
 }
 
-void UPortalPostCrossingState::OnStateExited_Implementation(const FGameplayTag& ToState)
+void UPortalPostCrossingState::OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState)
 {
-	Super::OnStateExited_Implementation(ToState);
+	Super::OnStateExited_Implementation(Context, ToState);
 
-	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(this,0);
-	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(Context.Owner,0);
+	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0));
 	PlayerController->SetViewTargetWithBlend(PCharacter,0);
 }
 
-void UPortalPostCrossingState::Update(float DeltaTime)
-{
-	Super::Update(DeltaTime);
-	
-	// Update Player Camera
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
-	if (!PortalDoor)
-	{
-		return;
-	}
-	
-	PortalDoor->UpdatePortalCameraTransform();
-	PortalDoor->UpdateViewCameraTransform();
-}
-
 /*
  * PortalLinkPostCrossingState
  */
@@ -206,56 +193,88 @@ UPortalLinkPostCrossingState::UPortalLinkPostCrossingState()
 	StateTag = GameplayTags::Portal::LinkPostCrossing;
 }
 
-void UPortalLinkPostCrossingState::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UPortalLinkPostCrossingState::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	Super::OnStateEntered_Implementation(FromState);
+	Super::OnStateEntered_Implementation(Context, FromState);
 
-	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0));
 	ensure(PCharacter);
-	if (USpringArmComponent* SpringArm = PCharacter->GetCameraBoom())
+	USpringArmComponent* SpringArm = PCharacter->GetCameraBoom();
+	if (SpringArm && !IsCameraThroughPortal(PCharacter))
 	{
 		SpringArm->bDoCollisionTest = false;
 	}
-	
+
+	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get()))
+	{
+		PortalDoor->SetViewUpdate(EPortalViewUpdate::PortalCamera);
+	}
 }
 
-void UPortalLinkPostCrossingState::OnStateExited_Implementation(const FGameplayTag& ToState)
+void UPortalLinkPostCrossingState::OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState)
 {
-	Super::OnStateExited_Implementation(ToState);
-	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	Super::OnStateExited_Implementation(Context, ToState);
+	if (APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get()))
+	{
+		PortalDoor->PostCrossingTrace.Invalidate();
+	}
+	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0));
 	ensure(PCharacter);
-	if (USpringArmComponent* SpringArm = PCharacter->GetCameraBoom())
+	USpringArmComponent* SpringArm = PCharacter->GetCameraBoom();
+	if (SpringArm && !IsCameraThroughPortal(PCharacter))
 	{
 		SpringArm->bDoCollisionTest = true;
 	}
 }
 
-void UPortalLinkPostCrossingState::Update(float DeltaTime)
+void UPortalLinkPostCrossingState::Update(const FStateContext& Context, float DeltaTime)
 {
-	Super::Update(DeltaTime);
-	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Owner.Get());
-	PortalDoor->UpdatePortalCameraTransform();
+	Super::Update(Context, DeltaTime);
+	APortalDoor* PortalDoor = static_cast<APortalDoor*>(Context.Owner.Get());
 
 	// Change State
-	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(Context.Owner,0));
 	if (!PCharacter)
 	{
 		return;
 	}
+
+	// The boom already follows the camera through portals, once it no longer passes one the view is back on this side
+	if (const UPortalSpringArmComponent* PortalBoom = Cast<UPortalSpringArmComponent>(PCharacter->GetCameraBoom());
+		PortalBoom && PortalBoom->IsTracingThroughPortals())
+	{
+		if (!PortalBoom->GetPortalDoor())
+		{
+			PortalDoor->StateMachine->TryChangeState(GameplayTags::Portal::Active);
+			if (auto LinkDoor = PortalDoor->GetLinkPortal())
+			{
+				LinkDoor->StateMachine->TryChangeState(GameplayTags::Portal::LinkActive);
+			}
+		}
+		return;
+	}
 	
-	FVector StartTraceLoc = PCharacter->GetFollowCamera()->GetComponentLocation();
-	FVector EndTraceLoc = PCharacter->GetActorLocation();
-	FHitResult HitResult;
-	FCollisionQueryParams QueryParams;
-	bool bHit = GetWorld()->LineTraceSingleByChannel(HitResult, StartTraceLoc, EndTraceLoc,PORTAL_TRACE,QueryParams);
-	if (!bHit)
+	// Last frame's trace result, the physics query itself runs off the game thread
+	UWorld* World = Context.Owner->GetWorld();
+	FTraceDatum TraceDatum;
+	if (PortalDoor->PostCrossingTrace.IsValid() && World->QueryTraceData(PortalDoor->PostCrossingTrace, TraceDatum))
 	{
-		PortalDoor->StateMachine->TryChangeState(GameplayTags::Portal::Active);
-		if (auto LinkDoor = PortalDoor->GetLinkPortal())
+		const bool bHit = TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit;
+		if (!bHit)
 		{
-			LinkDoor->StateMachine->TryChangeState(GameplayTags::Portal::LinkActive);
+			PortalDoor->StateMachine->TryChangeState(GameplayTags::Portal::Active);
+			if (auto LinkDoor = PortalDoor->GetLinkPortal())
+			{
+				LinkDoor->StateMachine->TryChangeState(GameplayTags::Portal::LinkActive);
+			}
+			return;
 		}
 	}
+
+	FVector StartTraceLoc = PCharacter->GetFollowCamera()->GetComponentLocation();
+	FVector EndTraceLoc = PCharacter->GetActorLocation();
+	FCollisionQueryParams QueryParams;
+	PortalDoor->PostCrossingTrace = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, StartTraceLoc, EndTraceLoc, PORTAL_TRACE, QueryParams);
 }
 
 
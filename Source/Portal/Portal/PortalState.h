@@ -12,11 +12,11 @@ public:
 
 	UPortalUnActiveState();
 	
-	virtual void OnStateEntered_Implementation(const FGameplayTag& FromState) override;
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
 
-	virtual void OnStateExited_Implementation(const FGameplayTag& ToState) override;
+	virtual void OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState) override;
 
-	virtual bool CanUpdate() const override{return false;};
+	virtual bool CanUpdate(const FStateContext& Context) const override{return false;};
 };
 
 
@@ -28,9 +28,9 @@ public:
 
 	UPortalActiveState();
 	
-	virtual void OnStateEntered_Implementation(const FGameplayTag& FromState) override;
-	
-	virtual void Update(float DeltaTime) override;
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
+
+	virtual bool CanUpdate(const FStateContext& Context) const override{return false;};
 };
 
 UCLASS(Blueprintable, BlueprintType)
@@ -41,9 +41,9 @@ public:
 	
 	UPortalLinkActiveState();
 	
-	virtual void OnStateEntered_Implementation(const FGameplayTag& FromState) override;
-	
-	virtual void Update(float DeltaTime) override;
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
+
+	virtual bool CanUpdate(const FStateContext& Context) const override{return false;};
 };
 
 UCLASS(Blueprintable, BlueprintType)
@@ -53,10 +53,12 @@ class PORTAL_API UPortalCrossingState : public UStateBase
 public:
 
 	UPortalCrossingState();
+
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
 	
-	virtual void OnStateExited_Implementation(const FGameplayTag& ToState) override;
-	
-	virtual void Update(float DeltaTime) override;
+	virtual void OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState) override;
+
+	virtual bool CanUpdate(const FStateContext& Context) const override{return false;};
 };
 
 UCLASS(Blueprintable, BlueprintType)
@@ -67,11 +69,11 @@ public:
 	
 	UPortalLinkCrossingState();
 
-	virtual void OnStateEntered_Implementation(const FGameplayTag& FromState) override;
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
 
-	virtual void OnStateExited_Implementation(const FGameplayTag& ToState) override;
+	virtual void OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState) override;
 
-	virtual void Update(float DeltaTime) override;
+	virtual bool CanUpdate(const FStateContext& Context) const override{return false;};
 };
 
 UCLASS(Blueprintable, BlueprintType)
@@ -81,11 +83,11 @@ class PORTAL_API UPortalPostCrossingState : public UStateBase
 public:
 	UPortalPostCrossingState();
 
-	virtual void OnStateEntered_Implementation(const FGameplayTag& FromState) override;
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
 
-	virtual void OnStateExited_Implementation(const FGameplayTag& ToState) override;
+	virtual void OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState) override;
 
-	virtual void Update(float DeltaTime) override;
+	virtual bool CanUpdate(const FStateContext& Context) const override{return false;};
 };
 
 UCLASS(Blueprintable, BlueprintType)
@@ -95,9 +97,9 @@ class PORTAL_API UPortalLinkPostCrossingState : public UStateBase
 public:
 	UPortalLinkPostCrossingState();
 
-	virtual void OnStateEntered_Implementation(const FGameplayTag& FromState) override;
+	virtual void OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState) override;
 
-	virtual void OnStateExited_Implementation(const FGameplayTag& ToState) override;
+	virtual void OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState) override;
 	
-	virtual void Update(float DeltaTime) override;
+	virtual void Update(const FStateContext& Context, float DeltaTime) override;
 };
\ No newline at end of file
@@ -0,0 +1,388 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalSubsystem.h"
+
+#include "PortalDoor.h"
+#include "PortalMirrorProxy.h"
+#include "PortalCharacter.h"
+#include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/SpringArmComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Global/PortalStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("View Update"), STAT_PortalViewUpdate, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("View Updated Doors"), STAT_PortalViewUpdatedDoors, STATGROUP_Portal);
+
+void FPortalViewTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Subsystem)
+	{
+		Subsystem->UpdatePortalViews(Stage);
+	}
+}
+
+void FPortalViewBatch::Reset()
+{
+	Doors.Reset();
+	ViewUpdates.Reset();
+	ThroughTransforms.Reset();
+	ThroughRelativeTransforms.Reset();
+	MirrorSourceTransforms.Reset();
+	PortalCameraTransforms.Reset();
+	ViewCameraTransforms.Reset();
+	MirrorTransforms.Reset();
+}
+
+bool UPortalSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPortalSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Pawn stage runs after movement, before the camera managers are updated
+	PawnViewTickFunction.Subsystem = this;
+	PawnViewTickFunction.Stage = EPortalViewUpdate::ViewCamera | EPortalViewUpdate::MirrorProxy;
+	PawnViewTickFunction.TickGroup = TG_PostPhysics;
+	PawnViewTickFunction.bCanEverTick = true;
+	PawnViewTickFunction.bStartWithTickEnabled = ViewDoors.Num() > 0;
+	PawnViewTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+
+	// No camera manager prerequisite: its actor tick doesn't compute the view. UWorld::Tick runs
+	// UpdateCameraManager after TG_PostPhysics and before TG_PostUpdateWork, so the final view is ready here.
+	CameraViewTickFunction.Subsystem = this;
+	CameraViewTickFunction.Stage = EPortalViewUpdate::PortalCamera;
+	CameraViewTickFunction.TickGroup = TG_PostUpdateWork;
+	CameraViewTickFunction.bCanEverTick = true;
+	CameraViewTickFunction.bStartWithTickEnabled = ViewDoors.Num() > 0;
+	CameraViewTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+	CameraViewTickFunction.AddPrerequisite(this, PawnViewTickFunction);
+
+	UpdateTickPrerequisites();
+}
+
+void UPortalSubsystem::Deinitialize()
+{
+	for (FPortalViewTickFunction* TickFunction : {&PawnViewTickFunction, &CameraViewTickFunction})
+	{
+		if (TickFunction->IsTickFunctionRegistered())
+		{
+			TickFunction->UnRegisterTickFunction();
+		}
+	}
+
+	Portals.Empty();
+	LinkDependents.Empty();
+	ViewDoors.Empty();
+	CaptureMovers.Empty();
+
+	Super::Deinitialize();
+}
+
+void UPortalSubsystem::RegisterPortal(APortalDoor* Door)
+{
+	if (!Door || Door->PortalTag.IsNone())
+	{
+		return;
+	}
+
+	if (const TWeakObjectPtr<APortalDoor>* Existing = Portals.Find(Door->PortalTag))
+	{
+		if (Existing->IsValid() && Existing->Get() != Door)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Portal tag %s is already used by %s, %s will not be registered."),
+				*Door->PortalTag.ToString(), *Existing->Get()->GetName(), *Door->GetName());
+			return;
+		}
+	}
+
+	Portals.Add(Door->PortalTag, Door);
+	LinkDependents.AddUnique(Door->LinkPortalTag, Door);
+
+	// Resolve this door's own link
+	if (APortalDoor* LinkDoor = FindPortal(Door->LinkPortalTag))
+	{
+		LinkPortal(Door, LinkDoor);
+	}
+
+	// Resolve doors which were waiting for this one
+	TArray<TWeakObjectPtr<APortalDoor>, TInlineAllocator<2>> Dependents;
+	LinkDependents.MultiFind(Door->PortalTag, Dependents);
+	for (const TWeakObjectPtr<APortalDoor>& Dependent : Dependents)
+	{
+		if (Dependent.IsValid() && Dependent.Get() != Door)
+		{
+			LinkPortal(Dependent.Get(), Door);
+		}
+	}
+}
+
+void UPortalSubsystem::UnregisterPortal(APortalDoor* Door)
+{
+	if (!Door)
+	{
+		return;
+	}
+
+	const TWeakObjectPtr<APortalDoor>* Registered = Portals.Find(Door->PortalTag);
+	if (!Registered || Registered->Get() != Door)
+	{
+		return;
+	}
+
+	Portals.Remove(Door->PortalTag);
+	LinkDependents.RemoveSingle(Door->LinkPortalTag, Door);
+	UnlinkPortal(Door);
+
+	TArray<TWeakObjectPtr<APortalDoor>, TInlineAllocator<2>> Dependents;
+	LinkDependents.MultiFind(Door->PortalTag, Dependents);
+	for (const TWeakObjectPtr<APortalDoor>& Dependent : Dependents)
+	{
+		if (Dependent.IsValid())
+		{
+			UnlinkPortal(Dependent.Get());
+		}
+	}
+}
+
+void UPortalSubsystem::RegisterCaptureMover(AActor* Mover)
+{
+	if (Mover)
+	{
+		CaptureMovers.AddUnique(Mover);
+	}
+}
+
+void UPortalSubsystem::UnregisterCaptureMover(AActor* Mover)
+{
+	CaptureMovers.RemoveAllSwap([Mover](const TWeakObjectPtr<AActor>& CaptureMover)
+	{
+		return !CaptureMover.IsValid() || CaptureMover.Get() == Mover;
+	});
+}
+
+APortalDoor* UPortalSubsystem::FindPortal(const FName PortalTag) const
+{
+	if (const TWeakObjectPtr<APortalDoor>* Door = Portals.Find(PortalTag))
+	{
+		return Door->Get();
+	}
+	return nullptr;
+}
+
+void UPortalSubsystem::LinkPortal(APortalDoor* Door, APortalDoor* LinkDoor)
+{
+	if (Door->LinkPortal.Get() == LinkDoor)
+	{
+		return;
+	}
+
+	Door->OnLinkPortalChanged(LinkDoor);
+	OnPortalLinkChanged.Broadcast(Door, LinkDoor);
+}
+
+void UPortalSubsystem::UnlinkPortal(APortalDoor* Door)
+{
+	if (Door->LinkPortal.IsExplicitlyNull())
+	{
+		return;
+	}
+
+	Door->OnLinkPortalChanged(nullptr);
+	OnPortalLinkChanged.Broadcast(Door, nullptr);
+}
+
+int64 UPortalSubsystem::GetRecursionPixels() const
+{
+	return RecursionPixelsFrame == GFrameCounter ? RecursionPixels : 0;
+}
+
+void UPortalSubsystem::AddRecursionPixels(const int64 Pixels)
+{
+	if (RecursionPixelsFrame != GFrameCounter)
+	{
+		RecursionPixelsFrame = GFrameCounter;
+		RecursionPixels = 0;
+	}
+	RecursionPixels += Pixels;
+}
+
+void UPortalSubsystem::SetPortalViewUpdate(APortalDoor* Door, const EPortalViewUpdate ViewUpdate)
+{
+	if (ViewUpdate == EPortalViewUpdate::None)
+	{
+		ViewDoors.RemoveSingleSwap(Door);
+	}
+	else
+	{
+		ViewDoors.AddUnique(Door);
+	}
+
+	for (FPortalViewTickFunction* TickFunction : {&PawnViewTickFunction, &CameraViewTickFunction})
+	{
+		if (TickFunction->IsTickFunctionRegistered())
+		{
+			TickFunction->SetTickFunctionEnable(ViewDoors.Num() > 0);
+		}
+	}
+}
+
+void UPortalSubsystem::UpdateTickPrerequisites()
+{
+	APawn* Pawn = UGameplayStatics::GetPlayerPawn(this,0);
+	if (PrerequisitePawn.Get() != Pawn)
+	{
+		// The follow camera is placed by the pawn and its camera boom
+		auto SetPawnPrerequisites = [this](APawn* InPawn, const bool bAdd)
+		{
+			TArray<FTickFunction*, TInlineAllocator<2>> TickFunctions{&InPawn->PrimaryActorTick};
+			if (USpringArmComponent* SpringArm = InPawn->FindComponentByClass<USpringArmComponent>())
+			{
+				TickFunctions.Add(&SpringArm->PrimaryComponentTick);
+			}
+			for (FTickFunction* TickFunction : TickFunctions)
+			{
+				bAdd ? PawnViewTickFunction.AddPrerequisite(InPawn, *TickFunction) : PawnViewTickFunction.RemovePrerequisite(InPawn, *TickFunction);
+			}
+		};
+		if (APawn* OldPawn = PrerequisitePawn.Get())
+		{
+			SetPawnPrerequisites(OldPawn, false);
+		}
+		if (Pawn)
+		{
+			SetPawnPrerequisites(Pawn, true);
+		}
+		PrerequisitePawn = Pawn;
+	}
+}
+
+void UPortalSubsystem::UpdatePortalViews(const EPortalViewUpdate Stage)
+{
+	SCOPE_CYCLE_COUNTER(STAT_PortalViewUpdate);
+
+	if (EnumHasAnyFlags(Stage, EPortalViewUpdate::ViewCamera))
+	{
+		// Prerequisite changes apply from the next frame
+		UpdateTickPrerequisites();
+	}
+
+	const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this,0);
+	if (!CameraManager)
+	{
+		return;
+	}
+	const FTransform CameraTransform = CameraManager->GetTransform();
+
+	const APortalCharacter* PCharacter = Cast<APortalCharacter>(UGameplayStatics::GetPlayerCharacter(this,0));
+	const UCameraComponent* FollowCamera = PCharacter ? PCharacter->GetFollowCamera() : nullptr;
+	const FTransform FollowCameraTransform = FollowCamera ? FollowCamera->GetComponentTransform() : CameraTransform;
+
+	// Gather the linked doors into contiguous arrays
+	ViewBatch.Reset();
+	for (int32 Index = ViewDoors.Num() - 1; Index >= 0; --Index)
+	{
+		APortalDoor* Door = ViewDoors[Index].Get();
+		if (!Door)
+		{
+			ViewDoors.RemoveAtSwap(Index);
+			continue;
+		}
+
+		if (!Door->GetLinkPortal())
+		{
+			continue;
+		}
+
+		const USkeletalMeshComponent* SourceMesh = Door->MirrorProxy ? Door->MirrorProxy->GetSourceMesh() : nullptr;
+		EPortalViewUpdate ViewUpdate = Door->GetViewUpdate() & Stage;
+		if (!SourceMesh)
+		{
+			ViewUpdate &= ~EPortalViewUpdate::MirrorProxy;
+		}
+		if (ViewUpdate == EPortalViewUpdate::None)
+		{
+			continue;
+		}
+
+		ViewBatch.Doors.Add(Door);
+		ViewBatch.ViewUpdates.Add(ViewUpdate);
+		const FPortalThroughTransform& Through = Door->GetThroughTransform();
+		ViewBatch.ThroughTransforms.Add(Through.GetTransform());
+		ViewBatch.ThroughRelativeTransforms.Add(Through.GetRelativeTransform());
+		ViewBatch.MirrorSourceTransforms.Add(SourceMesh ? SourceMesh->GetComponentTransform() : FTransform::Identity);
+	}
+
+	const int32 NumDoors = ViewBatch.Doors.Num();
+	INC_DWORD_STAT_BY(STAT_PortalViewUpdatedDoors, NumDoors);
+	if (NumDoors == 0)
+	{
+		return;
+	}
+
+	// Compute every view from the gathered transforms only
+	ViewBatch.PortalCameraTransforms.SetNumUninitialized(NumDoors);
+	ViewBatch.ViewCameraTransforms.SetNumUninitialized(NumDoors);
+	ViewBatch.MirrorTransforms.SetNumUninitialized(NumDoors);
+	for (int32 Index = 0; Index < NumDoors; ++Index)
+	{
+		const EPortalViewUpdate ViewUpdate = ViewBatch.ViewUpdates[Index];
+		const FTransform& Through = ViewBatch.ThroughTransforms[Index];
+
+		if (EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::PortalCamera))
+		{
+			FTransform::Multiply(&ViewBatch.PortalCameraTransforms[Index], &CameraTransform, &ViewBatch.ThroughRelativeTransforms[Index]);
+		}
+		if (EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::ViewCamera))
+		{
+			FTransform::Multiply(&ViewBatch.ViewCameraTransforms[Index], &FollowCameraTransform, &Through);
+		}
+		if (EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::MirrorProxy))
+		{
+			FTransform::Multiply(&ViewBatch.MirrorTransforms[Index], &ViewBatch.MirrorSourceTransforms[Index], &Through);
+		}
+	}
+
+	// Apply the transforms, none of these components collide so nothing else runs per move.
+	// Updates are deferred per door, each moved component and its children propagate once when the scopes close.
+	for (int32 Index = 0; Index < NumDoors; ++Index)
+	{
+		APortalDoor* Door = ViewBatch.Doors[Index];
+		const EPortalViewUpdate ViewUpdate = ViewBatch.ViewUpdates[Index];
+
+		FScopedMovementUpdate PortalCameraScope(EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::PortalCamera)
+			? Door->PortalCamera : nullptr, EScopedUpdate::DeferredUpdates);
+		FScopedMovementUpdate ViewCameraScope(EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::ViewCamera)
+			? Door->ViewCamera : nullptr, EScopedUpdate::DeferredUpdates);
+		FScopedMovementUpdate MirrorProxyScope(EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::MirrorProxy)
+			? Door->MirrorProxy->GetMesh() : nullptr, EScopedUpdate::DeferredUpdates);
+
+		if (EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::PortalCamera))
+		{
+			Door->PortalCamera->SetRelativeTransform(ViewBatch.PortalCameraTransforms[Index]);
+		}
+		if (EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::ViewCamera))
+		{
+			Door->ViewCamera->SetWorldTransform(ViewBatch.ViewCameraTransforms[Index]);
+		}
+		if (EnumHasAnyFlags(ViewUpdate, EPortalViewUpdate::MirrorProxy))
+		{
+			Door->MirrorProxy->GetMesh()->SetWorldTransform(ViewBatch.MirrorTransforms[Index]);
+		}
+	}
+
+	// Captures last, so recursive captures see every camera of this frame in place
+	for (int32 Index = 0; Index < NumDoors; ++Index)
+	{
+		if (EnumHasAnyFlags(ViewBatch.ViewUpdates[Index], EPortalViewUpdate::PortalCamera))
+		{
+			ViewBatch.Doors[Index]->UpdatePortalRendering();
+		}
+	}
+}
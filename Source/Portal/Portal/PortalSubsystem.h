@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalSubsystem.generated.h"
+
+class AActor;
+class APawn;
+class APortalDoor;
+class UPortalSubsystem;
+enum class EPortalViewUpdate : uint8;
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnPortalLinkChanged, APortalDoor* /*Door*/, APortalDoor* /*LinkDoor*/);
+
+/**
+ * One stage of UPortalSubsystem's view pass.
+ * The pawn stage places what follows the player pawn, before the camera manager reads its view target.
+ * The camera stage places and captures the PortalCameras once the camera manager has the final view.
+ */
+struct FPortalViewTickFunction : public FTickFunction
+{
+	UPortalSubsystem* Subsystem{nullptr};
+
+	/** Views this stage updates */
+	EPortalViewUpdate Stage{};
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override { return TEXT("FPortalViewTickFunction"); }
+};
+
+/** Per-frame arrays of the view pass, one entry per updated door, kept between frames to avoid reallocating */
+struct FPortalViewBatch
+{
+	TArray<APortalDoor*> Doors;
+	TArray<EPortalViewUpdate> ViewUpdates;
+	TArray<FTransform> ThroughTransforms;
+	TArray<FTransform> ThroughRelativeTransforms;
+	TArray<FTransform> MirrorSourceTransforms;
+	TArray<FTransform> PortalCameraTransforms;
+	TArray<FTransform> ViewCameraTransforms;
+	TArray<FTransform> MirrorTransforms;
+
+	void Reset();
+};
+
+/**
+ * World-wide registry of portal doors.
+ * Doors are indexed by PortalTag, and LinkPortalTag pairs are resolved once on registration,
+ * so doors never have to search the world for their partner.
+ */
+UCLASS()
+class PORTAL_API UPortalSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	void RegisterPortal(APortalDoor* Door);
+	void UnregisterPortal(APortalDoor* Door);
+
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	APortalDoor* FindPortal(FName PortalTag) const;
+
+	const TMap<FName, TWeakObjectPtr<APortalDoor>>& GetPortals() const { return Portals; }
+
+	/**
+	 * Actors whose primitives dirty the captures that see them, see r.Portal.DirtyTracking.
+	 * Traversers and mirror proxies register themselves; other movers shown through portals opt in here.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	void RegisterCaptureMover(AActor* Mover);
+
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	void UnregisterCaptureMover(AActor* Mover);
+
+	const TArray<TWeakObjectPtr<AActor>>& GetCaptureMovers() const { return CaptureMovers; }
+
+	/** Broadcast when a door gets (LinkDoor != nullptr) or loses (LinkDoor == nullptr) its link. */
+	FOnPortalLinkChanged OnPortalLinkChanged;
+
+	/** Pixels all doors rendered in recursive captures this frame, checked against r.Portal.Recursion.PixelBudget. */
+	int64 GetRecursionPixels() const;
+	void AddRecursionPixels(int64 Pixels);
+
+	/** Called by APortalDoor::SetViewUpdate */
+	void SetPortalViewUpdate(APortalDoor* Door, EPortalViewUpdate ViewUpdate);
+
+	/**
+	 * Places the cameras and mirror proxies of every door with a view update in one pass, reading the
+	 * player camera once, then updates their captures. Only the views in Stage are touched.
+	 */
+	void UpdatePortalViews(EPortalViewUpdate Stage);
+
+protected:
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+
+	void LinkPortal(APortalDoor* Door, APortalDoor* LinkDoor);
+	void UnlinkPortal(APortalDoor* Door);
+
+	/** PortalTag -> Door */
+	TMap<FName, TWeakObjectPtr<APortalDoor>> Portals;
+
+	/** LinkPortalTag -> Doors that link to that tag, linked or still waiting for their partner */
+	TMultiMap<FName, TWeakObjectPtr<APortalDoor>> LinkDependents;
+
+	int64 RecursionPixels{0};
+	uint64 RecursionPixelsFrame{MAX_uint64};
+
+	TArray<TWeakObjectPtr<AActor>> CaptureMovers;
+
+	/** Doors with a view update other than None */
+	TArray<TWeakObjectPtr<APortalDoor>> ViewDoors;
+
+	/** Keeps the pawn stage after the pawn and camera boom it reads, refreshed when the pawn changes */
+	void UpdateTickPrerequisites();
+
+	FPortalViewTickFunction PawnViewTickFunction;
+	FPortalViewTickFunction CameraViewTickFunction;
+
+	TWeakObjectPtr<APawn> PrerequisitePawn{nullptr};
+
+	FPortalViewBatch ViewBatch;
+};
@@ -0,0 +1,11 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalThroughTransform.h"
+
+FPortalThroughTransform::FPortalThroughTransform(const FTransform& LinkDoorTransform, const FTransform& DoorTransform)
+{
+	const FQuat RotUp180Quat(LinkDoorTransform.GetRotation().GetUpVector(), UE_DOUBLE_PI);
+	RelativeTransform = LinkDoorTransform.Inverse() * FTransform(RotUp180Quat);
+	Transform = RelativeTransform * DoorTransform;
+}
@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Maps world space in front of a link door to world space in front of the door it leads to:
+ * relative to the link door, turned 180 degrees around its up axis, then placed on the door.
+ * Built once per pair and kept until either door moves. Scale of the mapped transforms passes through.
+ */
+struct PORTAL_API FPortalThroughTransform
+{
+	FPortalThroughTransform() = default;
+	FPortalThroughTransform(const FTransform& LinkDoorTransform, const FTransform& DoorTransform);
+
+	/** Link door world space to door world space */
+	const FTransform& GetTransform() const { return Transform; }
+
+	/** Link door world space to the door's local space, for components attached to the door */
+	const FTransform& GetRelativeTransform() const { return RelativeTransform; }
+
+	FTransform TransformTransform(const FTransform& InTransform) const { return InTransform * Transform; }
+	FVector TransformPosition(const FVector& Position) const { return Transform.TransformPosition(Position); }
+	FVector TransformDirection(const FVector& Direction) const { return Transform.TransformVectorNoScale(Direction); }
+
+private:
+
+	FTransform Transform{FTransform::Identity};
+	FTransform RelativeTransform{FTransform::Identity};
+};
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTraversalComponent.h"
+
+#include "PortalSubsystem.h"
+#include "PortalTraversalSubsystem.h"
+
+UPortalTraversalComponent::UPortalTraversalComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UPortalTraversalComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UPortalTraversalSubsystem* TraversalSubsystem = UWorld::GetSubsystem<UPortalTraversalSubsystem>(GetWorld()))
+	{
+		TraversalSubsystem->RegisterTraverser(this);
+	}
+	if (UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld()))
+	{
+		PortalSubsystem->RegisterCaptureMover(GetOwner());
+	}
+}
+
+void UPortalTraversalComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPortalTraversalSubsystem* TraversalSubsystem = UWorld::GetSubsystem<UPortalTraversalSubsystem>(GetWorld()))
+	{
+		TraversalSubsystem->UnregisterTraverser(this);
+	}
+	if (UPortalSubsystem* PortalSubsystem = UWorld::GetSubsystem<UPortalSubsystem>(GetWorld()))
+	{
+		PortalSubsystem->UnregisterCaptureMover(GetOwner());
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool UPortalTraversalComponent::IsInTransit() const
+{
+	const UPortalTraversalSubsystem* TraversalSubsystem = UWorld::GetSubsystem<UPortalTraversalSubsystem>(GetWorld());
+	return TraversalSubsystem && TraversalSubsystem->IsInTransit(this);
+}
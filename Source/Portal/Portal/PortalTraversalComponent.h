@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "PortalTraversalComponent.generated.h"
+
+class APortalDoor;
+
+/** CrossingPoint is where the owner passed FromDoor's plane, CrossingTime the world time it did so within the tick. */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnPortalTraversed, APortalDoor*, FromDoor, APortalDoor*, ToDoor, FVector, CrossingPoint, double, CrossingTime);
+
+/**
+ * Lets the owning actor cross portal doors: AI pawns, physics bodies, projectiles.
+ * Crossing state lives in UPortalTraversalSubsystem, which checks every traverser in one tick,
+ * so this component never ticks. The local player keeps crossing through the door state machine,
+ * which also hands over the camera, and should not carry one.
+ */
+UCLASS(ClassGroup=(Portal), meta=(BlueprintSpawnableComponent))
+class PORTAL_API UPortalTraversalComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	UPortalTraversalComponent();
+
+	/** True from a teleport until the owner is farther than r.Portal.Traversal.Margin from the exit door's plane. */
+	UFUNCTION(BlueprintPure, Category = "Portal")
+	bool IsInTransit() const;
+
+	UPROPERTY(BlueprintAssignable, Category = "Portal")
+	FOnPortalTraversed OnPortalTraversed;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+
+	friend class UPortalTraversalSubsystem;
+
+	/** Slot in UPortalTraversalSubsystem's traverser arrays */
+	int32 TraversalIndex{INDEX_NONE};
+};
@@ -0,0 +1,614 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTraversalSubsystem.h"
+
+#include "PortalDoor.h"
+#include "PortalSubsystem.h"
+#include "PortalTraversalComponent.h"
+#include "Components/BoxComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/Character.h"
+#include "Kismet/GameplayStatics.h"
+#include "Global/PortalStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Traversal"), STAT_PortalTraversal, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Traversers"), STAT_PortalTraversers, STATGROUP_Portal);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Swept Pairs"), STAT_PortalSweptPairs, STATGROUP_Portal);
+
+static TAutoConsoleVariable<int32> CVarPortalSweptCrossing(
+	TEXT("r.Portal.SweptCrossing"),
+	1,
+	TEXT("0: the local player crosses through the doors' activation and crossing overlap boxes.\n")
+	TEXT("1: the boxes have no collision, the traversal subsystem tests the player's zones and sweeps its movement against the door planes. Read when play begins."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarPortalTraversalMargin(
+	TEXT("r.Portal.Traversal.Margin"),
+	200.0f,
+	TEXT("Distance from a door plane within which traversers count as near the door."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarPortalTraversalCellSize(
+	TEXT("r.Portal.Traversal.CellSize"),
+	1000.0f,
+	TEXT("Cell size of the spatial hash matching traversers to nearby doors."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarPortalTraversalMaxSweep(
+	TEXT("r.Portal.Traversal.MaxSweep"),
+	2000.0f,
+	TEXT("Longer moves in one tick are treated as teleports and not swept."),
+	ECVF_Default);
+
+static FIntVector GetTraversalCell(const FVector& Location, const double CellSize)
+{
+	return FIntVector(FMath::FloorToInt32(Location.X / CellSize),
+		FMath::FloorToInt32(Location.Y / CellSize),
+		FMath::FloorToInt32(Location.Z / CellSize));
+}
+
+/** Box test in the box's unscaled frame, grown by the character's capsule like the overlap it replaces. */
+static bool IsInDetectionBox(const UBoxComponent* Box, const FVector& Location, const FVector& Inflate)
+{
+	const FVector LocalLocation = Box->GetComponentTransform().InverseTransformPositionNoScale(Location);
+	const FVector Extent = Box->GetScaledBoxExtent() + Inflate;
+	return FMath::Abs(LocalLocation.X) <= Extent.X
+		&& FMath::Abs(LocalLocation.Y) <= Extent.Y
+		&& FMath::Abs(LocalLocation.Z) <= Extent.Z;
+}
+
+void FPortalTraversers::Add(UPortalTraversalComponent* Component)
+{
+	Components.Add(Component);
+	Locations.Add(Component->GetOwner()->GetActorLocation());
+	ExitDoors.Add(nullptr);
+	InTransit.Add(false);
+}
+
+void FPortalTraversers::RemoveAtSwap(const int32 Index)
+{
+	Components.RemoveAtSwap(Index);
+	Locations.RemoveAtSwap(Index);
+	ExitDoors.RemoveAtSwap(Index);
+	InTransit.RemoveAtSwap(Index);
+}
+
+int32 FPortalTraversalDoors::Add(APortalDoor* Door)
+{
+	const int32 Index = Doors.Add(Door);
+	Locations.AddDefaulted();
+	Normals.AddDefaulted();
+	Rights.AddDefaulted();
+	Ups.AddDefaulted();
+	Centers.AddDefaulted();
+	HalfExtents.AddDefaulted();
+	MinCells.AddDefaulted();
+	MaxCells.AddDefaulted();
+	Moved.Add(false);
+	UpdateDoor(Index);
+	AddCells(Index);
+	return Index;
+}
+
+void FPortalTraversalDoors::RemoveAtSwap(const int32 Index)
+{
+	// The last door takes the slot, its cells have to point at the new index
+	const int32 LastIndex = Doors.Num() - 1;
+	RemoveCells(Index);
+	if (Index != LastIndex)
+	{
+		RemoveCells(LastIndex);
+	}
+
+	Doors.RemoveAtSwap(Index);
+	Locations.RemoveAtSwap(Index);
+	Normals.RemoveAtSwap(Index);
+	Rights.RemoveAtSwap(Index);
+	Ups.RemoveAtSwap(Index);
+	Centers.RemoveAtSwap(Index);
+	HalfExtents.RemoveAtSwap(Index);
+	MinCells.RemoveAtSwap(Index);
+	MaxCells.RemoveAtSwap(Index);
+	Moved.RemoveAtSwap(Index);
+
+	if (Index != LastIndex)
+	{
+		AddCells(Index);
+	}
+}
+
+void FPortalTraversalDoors::UpdateMoved()
+{
+	if (!bAnyMoved)
+	{
+		return;
+	}
+
+	bAnyMoved = false;
+	for (int32 Index = 0; Index < Num(); ++Index)
+	{
+		if (Moved[Index])
+		{
+			Moved[Index] = false;
+			RemoveCells(Index);
+			UpdateDoor(Index);
+			AddCells(Index);
+		}
+	}
+}
+
+void FPortalTraversalDoors::Rebuild(const double InMargin, const double InCellSize)
+{
+	Margin = InMargin;
+	CellSize = InCellSize;
+	Cells.Reset();
+	bAnyMoved = false;
+	for (int32 Index = 0; Index < Num(); ++Index)
+	{
+		Moved[Index] = false;
+		UpdateDoor(Index);
+		AddCells(Index);
+	}
+}
+
+void FPortalTraversalDoors::UpdateDoor(const int32 Index)
+{
+	// Extent of the Plane's world box along the door axes
+	const APortalDoor* Door = Doors[Index];
+	const FBoxSphereBounds& Bounds = Door->Plane->Bounds;
+	const FVector Right = Door->GetActorRightVector();
+	const FVector Up = Door->GetActorUpVector();
+	Locations[Index] = Door->GetActorLocation();
+	Normals[Index] = Door->GetDoorForwardDirection();
+	Rights[Index] = Right;
+	Ups[Index] = Up;
+	Centers[Index] = Bounds.Origin;
+	HalfExtents[Index] = FVector2D(FVector::DotProduct(Right.GetAbs(), Bounds.BoxExtent), FVector::DotProduct(Up.GetAbs(), Bounds.BoxExtent));
+
+	// The detection boxes are included, so the player's cell also finds every zone it can be in
+	const FBox CellBounds = Bounds.GetBox() + Door->ActivateDetectionBox->Bounds.GetBox() + Door->CrossingDetectionBox->Bounds.GetBox();
+	MinCells[Index] = GetTraversalCell(CellBounds.Min - FVector(Margin), CellSize);
+	MaxCells[Index] = GetTraversalCell(CellBounds.Max + FVector(Margin), CellSize);
+}
+
+void FPortalTraversalDoors::AddCells(const int32 Index)
+{
+	for (int32 X = MinCells[Index].X; X <= MaxCells[Index].X; ++X)
+	{
+		for (int32 Y = MinCells[Index].Y; Y <= MaxCells[Index].Y; ++Y)
+		{
+			for (int32 Z = MinCells[Index].Z; Z <= MaxCells[Index].Z; ++Z)
+			{
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(Index);
+			}
+		}
+	}
+}
+
+void FPortalTraversalDoors::RemoveCells(const int32 Index)
+{
+	for (int32 X = MinCells[Index].X; X <= MaxCells[Index].X; ++X)
+	{
+		for (int32 Y = MinCells[Index].Y; Y <= MaxCells[Index].Y; ++Y)
+		{
+			for (int32 Z = MinCells[Index].Z; Z <= MaxCells[Index].Z; ++Z)
+			{
+				const FIntVector Cell(X, Y, Z);
+				TArray<int32, TInlineAllocator<4>>* CellDoors = Cells.Find(Cell);
+				if (CellDoors && CellDoors->RemoveSingleSwap(Index) > 0 && CellDoors->IsEmpty())
+				{
+					Cells.Remove(Cell);
+				}
+			}
+		}
+	}
+}
+
+void FPortalSweepBatch::Reset()
+{
+	Starts.Reset();
+	Ends.Reset();
+	PairSegments.Reset();
+	PairDoors.Reset();
+	PairTimes.Reset();
+	PairPoints.Reset();
+	PairDirections.Reset();
+}
+
+void UPortalTraversalSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Before any actor BeginPlay, so every door sees the same value
+	bSweptCrossing = CVarPortalSweptCrossing.GetValueOnGameThread() != 0;
+}
+
+bool UPortalTraversalSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPortalTraversalSubsystem::Deinitialize()
+{
+	for (UPortalTraversalComponent* Component : Traversers.Components)
+	{
+		Component->TraversalIndex = INDEX_NONE;
+	}
+	for (APortalDoor* Door : TraversalDoors.Doors)
+	{
+		Door->TraversalIndex = INDEX_NONE;
+	}
+	Traversers = FPortalTraversers();
+	TraversalDoors = FPortalTraversalDoors();
+	SweepBatch = FPortalSweepBatch();
+	PlayerZoneDoors.Reset();
+
+	Super::Deinitialize();
+}
+
+TStatId UPortalTraversalSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPortalTraversalSubsystem, STATGROUP_Portal);
+}
+
+void UPortalTraversalSubsystem::RegisterTraverser(UPortalTraversalComponent* Component)
+{
+	if (!Component || Component->TraversalIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	Component->TraversalIndex = Traversers.Num();
+	Traversers.Add(Component);
+}
+
+void UPortalTraversalSubsystem::UnregisterTraverser(UPortalTraversalComponent* Component)
+{
+	if (!Component || !Traversers.Components.IsValidIndex(Component->TraversalIndex))
+	{
+		return;
+	}
+
+	const int32 Index = Component->TraversalIndex;
+	Traversers.RemoveAtSwap(Index);
+	if (Traversers.Components.IsValidIndex(Index))
+	{
+		Traversers.Components[Index]->TraversalIndex = Index;
+	}
+	Component->TraversalIndex = INDEX_NONE;
+}
+
+bool UPortalTraversalSubsystem::IsInTransit(const UPortalTraversalComponent* Component) const
+{
+	return Component && Traversers.InTransit.IsValidIndex(Component->TraversalIndex) && Traversers.InTransit[Component->TraversalIndex];
+}
+
+void UPortalTraversalSubsystem::RegisterDoor(APortalDoor* Door)
+{
+	if (!Door || Door->TraversalIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	// Before the first tick the cells are built with the current CVars
+	if (TraversalDoors.CellSize <= 0.0)
+	{
+		TraversalDoors.Margin = FMath::Max(1.0f, CVarPortalTraversalMargin.GetValueOnGameThread());
+		TraversalDoors.CellSize = FMath::Max(100.0f, CVarPortalTraversalCellSize.GetValueOnGameThread());
+	}
+	Door->TraversalIndex = TraversalDoors.Add(Door);
+}
+
+void UPortalTraversalSubsystem::UnregisterDoor(APortalDoor* Door)
+{
+	if (!Door || !TraversalDoors.Doors.IsValidIndex(Door->TraversalIndex))
+	{
+		return;
+	}
+
+	const int32 Index = Door->TraversalIndex;
+	TraversalDoors.RemoveAtSwap(Index);
+	if (TraversalDoors.Doors.IsValidIndex(Index))
+	{
+		TraversalDoors.Doors[Index]->TraversalIndex = Index;
+	}
+	Door->TraversalIndex = INDEX_NONE;
+}
+
+void UPortalTraversalSubsystem::MarkDoorMoved(const APortalDoor* Door)
+{
+	if (Door && TraversalDoors.Moved.IsValidIndex(Door->TraversalIndex))
+	{
+		TraversalDoors.Moved[Door->TraversalIndex] = true;
+		TraversalDoors.bAnyMoved = true;
+	}
+}
+
+void UPortalTraversalSubsystem::GatherSweepPairs(const double CellSize)
+{
+	const double MaxSweepSquared = FMath::Square(FMath::Max(1.0f, CVarPortalTraversalMaxSweep.GetValueOnGameThread()));
+
+	for (int32 Segment = 0; Segment < SweepBatch.Starts.Num(); ++Segment)
+	{
+		const FVector& Start = SweepBatch.Starts[Segment];
+		const FVector& End = SweepBatch.Ends[Segment];
+		if (FVector::DistSquared(Start, End) > MaxSweepSquared)
+		{
+			continue;
+		}
+
+		const int32 FirstPair = SweepBatch.PairDoors.Num();
+		const FIntVector StartCell = GetTraversalCell(Start, CellSize);
+		const FIntVector EndCell = GetTraversalCell(End, CellSize);
+		for (const FIntVector& Cell : {StartCell, EndCell})
+		{
+			if (const TArray<int32, TInlineAllocator<4>>* CellDoors = TraversalDoors.Cells.Find(Cell))
+			{
+				for (const int32 DoorIndex : *CellDoors)
+				{
+					// A door touching both cells is paired once
+					bool bPaired = false;
+					for (int32 Pair = FirstPair; Pair < SweepBatch.PairDoors.Num() && !bPaired; ++Pair)
+					{
+						bPaired = SweepBatch.PairDoors[Pair] == DoorIndex;
+					}
+					if (!bPaired)
+					{
+						SweepBatch.PairSegments.Add(Segment);
+						SweepBatch.PairDoors.Add(DoorIndex);
+					}
+				}
+			}
+			if (StartCell == EndCell)
+			{
+				break;
+			}
+		}
+	}
+
+	const int32 NumPairs = SweepBatch.PairDoors.Num();
+	SweepBatch.PairTimes.SetNumUninitialized(NumPairs);
+	SweepBatch.PairPoints.SetNumUninitialized(NumPairs);
+	SweepBatch.PairDirections.SetNumUninitialized(NumPairs);
+	INC_DWORD_STAT_BY(STAT_PortalSweptPairs, NumPairs);
+}
+
+void UPortalTraversalSubsystem::SweepPairs()
+{
+	for (int32 Pair = 0; Pair < SweepBatch.PairDoors.Num(); ++Pair)
+	{
+		const int32 Segment = SweepBatch.PairSegments[Pair];
+		const int32 DoorIndex = SweepBatch.PairDoors[Pair];
+		SweepBatch.PairTimes[Pair] = -1.0;
+		SweepBatch.PairDirections[Pair] = 0;
+
+		const FVector& Start = SweepBatch.Starts[Segment];
+		const FVector& End = SweepBatch.Ends[Segment];
+		const FVector& DoorLocation = TraversalDoors.Locations[DoorIndex];
+		const FVector& Normal = TraversalDoors.Normals[DoorIndex];
+
+		const double StartSide = FVector::DotProduct(Start - DoorLocation, Normal);
+		const double EndSide = FVector::DotProduct(End - DoorLocation, Normal);
+		if ((StartSide >= 0.0) == (EndSide >= 0.0))
+		{
+			continue;
+		}
+
+		// Where the segment meets the plane, then inside the rectangle test
+		const double Time = StartSide / (StartSide - EndSide);
+		const FVector Point = Start + (End - Start) * Time;
+		const FVector ToCenter = Point - TraversalDoors.Centers[DoorIndex];
+		const FVector2D& HalfExtent = TraversalDoors.HalfExtents[DoorIndex];
+		if (FMath::Abs(FVector::DotProduct(ToCenter, TraversalDoors.Rights[DoorIndex])) > HalfExtent.X
+			|| FMath::Abs(FVector::DotProduct(ToCenter, TraversalDoors.Ups[DoorIndex])) > HalfExtent.Y)
+		{
+			continue;
+		}
+
+		SweepBatch.PairTimes[Pair] = Time;
+		SweepBatch.PairPoints[Pair] = Point;
+		SweepBatch.PairDirections[Pair] = StartSide >= 0.0 ? 1 : -1;
+	}
+}
+
+void UPortalTraversalSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const int32 NumTraversers = Traversers.Num();
+	SET_DWORD_STAT(STAT_PortalTraversers, NumTraversers);
+
+	ACharacter* Character = bSweptCrossing ? UGameplayStatics::GetPlayerCharacter(this,0) : nullptr;
+	if (!Character)
+	{
+		PlayerLocation.Reset();
+	}
+	if (NumTraversers == 0 && !Character)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_PortalTraversal);
+
+	const double Margin = FMath::Max(1.0f, CVarPortalTraversalMargin.GetValueOnGameThread());
+	const double CellSize = FMath::Max(100.0f, CVarPortalTraversalCellSize.GetValueOnGameThread());
+	if (Margin != TraversalDoors.Margin || CellSize != TraversalDoors.CellSize)
+	{
+		TraversalDoors.Rebuild(Margin, CellSize);
+	}
+	else
+	{
+		TraversalDoors.UpdateMoved();
+	}
+
+	// Segments from last tick's locations, the player's last
+	SweepBatch.Reset();
+	SweepBatch.Starts.Append(Traversers.Locations);
+	for (int32 Index = 0; Index < NumTraversers; ++Index)
+	{
+		Traversers.Locations[Index] = Traversers.Components[Index]->GetOwner()->GetActorLocation();
+	}
+	SweepBatch.Ends.Append(Traversers.Locations);
+	if (Character)
+	{
+		const FVector CharacterLocation = Character->GetActorLocation();
+		SweepBatch.Starts.Add(PlayerLocation.Get(CharacterLocation));
+		SweepBatch.Ends.Add(CharacterLocation);
+		PlayerLocation = CharacterLocation;
+	}
+
+	GatherSweepPairs(CellSize);
+	SweepPairs();
+
+	UpdateTraversers(DeltaTime, Margin);
+	if (Character)
+	{
+		UpdatePlayerZones(Character, CellSize);
+		// Crossing teleports the player, the next segment starts where it came out
+		PlayerLocation = Character->GetActorLocation();
+	}
+}
+
+void UPortalTraversalSubsystem::UpdateTraversers(const float DeltaTime, const double Margin)
+{
+	// Earliest front to back pass of each traverser
+	Crossings.Reset();
+	int32 LastSegment = INDEX_NONE;
+	for (int32 Pair = 0; Pair < SweepBatch.PairDoors.Num(); ++Pair)
+	{
+		const int32 Segment = SweepBatch.PairSegments[Pair];
+		if (Segment >= Traversers.Num() || SweepBatch.PairDirections[Pair] <= 0)
+		{
+			continue;
+		}
+
+		const double Time = SweepBatch.PairTimes[Pair];
+		if (Segment == LastSegment && Crossings.Last().Time <= Time)
+		{
+			continue;
+		}
+		if (Segment != LastSegment)
+		{
+			Crossings.AddDefaulted();
+			LastSegment = Segment;
+		}
+
+		FPortalCrossing& Crossing = Crossings.Last();
+		Crossing.Traverser = Traversers.Components[Segment];
+		Crossing.Door = TraversalDoors.Doors[SweepBatch.PairDoors[Pair]];
+		Crossing.Point = SweepBatch.PairPoints[Pair];
+		Crossing.Time = Time;
+	}
+
+	// Out of transit once clear of the exit door
+	for (int32 Index = 0; Index < Traversers.Num(); ++Index)
+	{
+		if (!Traversers.InTransit[Index])
+		{
+			continue;
+		}
+
+		const int32 DoorIndex = TraversalDoors.Doors.IndexOfByKey(Traversers.ExitDoors[Index]);
+		if (DoorIndex == INDEX_NONE
+			|| FMath::Abs(FVector::DotProduct(Traversers.Locations[Index] - TraversalDoors.Locations[DoorIndex], TraversalDoors.Normals[DoorIndex])) > Margin)
+		{
+			Traversers.InTransit[Index] = false;
+			Traversers.ExitDoors[Index] = nullptr;
+		}
+	}
+
+	// Teleports move actors and fire events which may unregister traversers, so indices are looked up again
+	const double TickStartTime = GetWorld()->GetTimeSeconds() - DeltaTime;
+	for (const FPortalCrossing& Crossing : Crossings)
+	{
+		UPortalTraversalComponent* Component = Crossing.Traverser.Get();
+		APortalDoor* Door = Crossing.Door.Get();
+		APortalDoor* LinkDoor = Door ? Door->GetLinkPortal() : nullptr;
+		if (!Component || Component->TraversalIndex == INDEX_NONE || !LinkDoor)
+		{
+			continue;
+		}
+
+		Door->TeleportActor(Component->GetOwner());
+		const int32 Index = Component->TraversalIndex;
+		if (Index == INDEX_NONE)
+		{
+			continue;
+		}
+
+		// The next segment starts on the far side, it is not swept back through the link door
+		Traversers.Locations[Index] = Component->GetOwner()->GetActorLocation();
+		Traversers.ExitDoors[Index] = LinkDoor;
+		Traversers.InTransit[Index] = true;
+
+		Component->OnPortalTraversed.Broadcast(Door, LinkDoor, Crossing.Point, TickStartTime + Crossing.Time * DeltaTime);
+	}
+}
+
+void UPortalTraversalSubsystem::UpdatePlayerZones(const ACharacter* Character, const double CellSize)
+{
+	const int32 PlayerSegment = SweepBatch.Starts.Num() - 1;
+	const FVector& Location = SweepBatch.Ends[PlayerSegment];
+	const UCapsuleComponent* Capsule = Character->GetCapsuleComponent();
+	const FVector Inflate = Capsule
+		? FVector(Capsule->GetScaledCapsuleRadius(), Capsule->GetScaledCapsuleRadius(), Capsule->GetScaledCapsuleHalfHeight())
+		: FVector::ZeroVector;
+
+	// Zones of doors outside the player's cell can't hold it, only the ones it was in still need to see it leave
+	TArray<int32, TInlineAllocator<8>> ZoneDoors;
+	if (const TArray<int32, TInlineAllocator<4>>* CellDoors = TraversalDoors.Cells.Find(GetTraversalCell(Location, CellSize)))
+	{
+		ZoneDoors.Append(*CellDoors);
+	}
+	for (const TWeakObjectPtr<APortalDoor>& ZoneDoor : PlayerZoneDoors)
+	{
+		const APortalDoor* Door = ZoneDoor.Get();
+		if (Door && TraversalDoors.Doors.IsValidIndex(Door->TraversalIndex))
+		{
+			ZoneDoors.AddUnique(Door->TraversalIndex);
+		}
+	}
+
+	// Swept pass of the player through each door, pairs of one segment are contiguous
+	int32 FirstPlayerPair = SweepBatch.PairDoors.Num();
+	while (FirstPlayerPair > 0 && SweepBatch.PairSegments[FirstPlayerPair - 1] == PlayerSegment)
+	{
+		--FirstPlayerPair;
+	}
+	for (int32 Pair = FirstPlayerPair; Pair < SweepBatch.PairDoors.Num(); ++Pair)
+	{
+		ZoneDoors.AddUnique(SweepBatch.PairDoors[Pair]);
+	}
+
+	// Zone changes switch door states and can teleport the player, so the doors are resolved up front and held weakly
+	TArray<TWeakObjectPtr<APortalDoor>, TInlineAllocator<8>> Doors;
+	TArray<int8, TInlineAllocator<8>> PlaneCrossings;
+	for (const int32 DoorIndex : ZoneDoors)
+	{
+		int8 PlaneCrossing = 0;
+		for (int32 Pair = FirstPlayerPair; Pair < SweepBatch.PairDoors.Num() && PlaneCrossing == 0; ++Pair)
+		{
+			PlaneCrossing = SweepBatch.PairDoors[Pair] == DoorIndex ? SweepBatch.PairDirections[Pair] : 0;
+		}
+		Doors.Add(TraversalDoors.Doors[DoorIndex]);
+		PlaneCrossings.Add(PlaneCrossing);
+	}
+
+	PlayerZoneDoors.Reset();
+	for (int32 Index = 0; Index < Doors.Num(); ++Index)
+	{
+		APortalDoor* Door = Doors[Index].Get();
+		if (!Door)
+		{
+			continue;
+		}
+
+		const bool bInActivation = IsInDetectionBox(Door->ActivateDetectionBox, Location, Inflate);
+		const bool bInCrossing = IsInDetectionBox(Door->CrossingDetectionBox, Location, Inflate);
+		Door->UpdatePlayerZones(bInActivation, bInCrossing, PlaneCrossings[Index]);
+		if (bInActivation || bInCrossing)
+		{
+			PlayerZoneDoors.Add(Door);
+		}
+	}
+}
@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalTraversalSubsystem.generated.h"
+
+class APortalDoor;
+class UPortalTraversalComponent;
+
+/** Crossing state of every registered actor, one entry per traverser */
+struct FPortalTraversers
+{
+	TArray<UPortalTraversalComponent*> Components;
+
+	/** Location at the end of the last tick, start of this tick's swept segment */
+	TArray<FVector> Locations;
+
+	/** Door the traverser came out of while in transit, compared only, never dereferenced */
+	TArray<const APortalDoor*> ExitDoors;
+
+	TArray<bool> InTransit;
+
+	int32 Num() const { return Components.Num(); }
+	void Add(UPortalTraversalComponent* Component);
+	void RemoveAtSwap(int32 Index);
+};
+
+/** All registered doors of the world with their Plane rectangle, kept up to date as doors register and move */
+struct FPortalTraversalDoors
+{
+	TArray<APortalDoor*> Doors;
+	TArray<FVector> Locations;
+	TArray<FVector> Normals;
+	TArray<FVector> Rights;
+	TArray<FVector> Ups;
+	TArray<FVector> Centers;
+	TArray<FVector2D> HalfExtents;
+
+	/** Uniform grid cell -> indices of the doors whose rectangle or detection boxes, grown by the tracking margin, touch it */
+	TMap<FIntVector, TArray<int32, TInlineAllocator<4>>> Cells;
+
+	/** Cell range each door was hashed to */
+	TArray<FIntVector> MinCells;
+	TArray<FIntVector> MaxCells;
+
+	/** The door moved since its entry was last updated */
+	TArray<bool> Moved;
+	bool bAnyMoved{false};
+
+	/** Margin and cell size the cells were built with */
+	double Margin{0.0};
+	double CellSize{0.0};
+
+	int32 Num() const { return Doors.Num(); }
+	int32 Add(APortalDoor* Door);
+	void RemoveAtSwap(int32 Index);
+
+	/** Refreshes the entries of the doors which moved */
+	void UpdateMoved();
+
+	/** Rehashes every door for a new margin or cell size */
+	void Rebuild(double InMargin, double InCellSize);
+
+private:
+
+	void UpdateDoor(int32 Index);
+	void AddCells(int32 Index);
+	void RemoveCells(int32 Index);
+};
+
+/** This tick's movement segments and their candidate doors, swept in one batch */
+struct FPortalSweepBatch
+{
+	/** One segment per traverser, then one for the local player */
+	TArray<FVector> Starts;
+	TArray<FVector> Ends;
+
+	TArray<int32> PairSegments;
+	TArray<int32> PairDoors;
+
+	/** Fraction of the tick at which the segment passed the door plane inside its rectangle, negative if it didn't */
+	TArray<double> PairTimes;
+	TArray<FVector> PairPoints;
+
+	/** 1 when passing from the front to the back of the door, -1 the other way */
+	TArray<int8> PairDirections;
+
+	void Reset();
+};
+
+/** Front to back pass of a traverser found by the sweep, applied once all segments were tested */
+struct FPortalCrossing
+{
+	TWeakObjectPtr<UPortalTraversalComponent> Traverser;
+	TWeakObjectPtr<APortalDoor> Door;
+	FVector Point{FVector::ZeroVector};
+	double Time{0.0};
+};
+
+/**
+ * Moves registered actors through portal doors.
+ * Each tick the traverser locations are gathered into contiguous arrays, and the segment each one moved
+ * along is swept against the rectangles of nearby doors, found through a spatial hash. Actors which passed
+ * through a door from the front are teleported to the link door with their velocity carried over.
+ * With r.Portal.SweptCrossing the local player's activation and crossing zones are also tested here,
+ * replacing the doors' overlap boxes.
+ */
+UCLASS()
+class PORTAL_API UPortalTraversalSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	/** r.Portal.SweptCrossing as it was when play began, doors read it to turn off their overlap boxes. */
+	bool IsSweptCrossingEnabled() const { return bSweptCrossing; }
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	void RegisterTraverser(UPortalTraversalComponent* Component);
+	void UnregisterTraverser(UPortalTraversalComponent* Component);
+
+	void RegisterDoor(APortalDoor* Door);
+	void UnregisterDoor(APortalDoor* Door);
+
+	/** Rehashes the door before the next sweep, its components have their final transforms by then. */
+	void MarkDoorMoved(const APortalDoor* Door);
+
+	bool IsInTransit(const UPortalTraversalComponent* Component) const;
+
+protected:
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+
+	/** Pairs every segment with the doors hashed to the cells of its start and end. */
+	void GatherSweepPairs(double CellSize);
+
+	/** Segment against door rectangle for every pair. */
+	void SweepPairs();
+
+	void UpdateTraversers(float DeltaTime, double Margin);
+
+	/** Tests the player's zones of the doors hashed to its cell and of the doors it was in a zone of. */
+	void UpdatePlayerZones(const ACharacter* Character, double CellSize);
+
+	/** Components unregister in EndPlay, before they can be collected */
+	FPortalTraversers Traversers;
+
+	/** Doors unregister in EndPlay as well */
+	FPortalTraversalDoors TraversalDoors;
+
+	FPortalSweepBatch SweepBatch;
+
+	TArray<FPortalCrossing> Crossings;
+
+	/** Doors only pick their crossing mode once, so the CVar is latched for the whole play session */
+	bool bSweptCrossing{false};
+
+	/** Player location at the end of the last tick, unset while there is no player */
+	TOptional<FVector> PlayerLocation;
+
+	/** Doors whose activation or crossing zone held the player after the last tick */
+	TArray<TWeakObjectPtr<APortalDoor>> PlayerZoneDoors;
+};
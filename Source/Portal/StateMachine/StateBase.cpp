@@ -3,32 +3,125 @@
 
 #include "StateBase.h"
 
-void UStateBase::OnStateEntered_Implementation(const FGameplayTag& FromState)
+void UStateBase::OnStateEntered_Implementation(const FStateContext& Context, const FGameplayTag& FromState)
 {
-	bActive = true;
-	UE_LOG(LogTemp,Display,TEXT("[OwnerName: %s] : UStateBase::OnStateEntered_Implementation() FromState %s, ToState %s"),
-		*Owner->GetName(), *FromState.GetTagName().ToString(),*StateTag.GetTagName().ToString());
+	// Transitions are recorded by UStateTransitionTrace, text logs are opt-in through LogTemp Verbose
+#if !UE_BUILD_SHIPPING
+	UE_LOG(LogTemp,Verbose,TEXT("[OwnerName: %s] : UStateBase::OnStateEntered_Implementation() FromState %s, ToState %s"),
+		*GetNameSafe(Context.Owner), *FromState.GetTagName().ToString(),*StateTag.GetTagName().ToString());
+#endif
 }
 
-void UStateBase::OnStateExited_Implementation(const FGameplayTag& ToState)
+void UStateBase::OnStateExited_Implementation(const FStateContext& Context, const FGameplayTag& ToState)
 {
-	bActive = false;
-	UE_LOG(LogTemp,Display,TEXT("[OwnerName: %s] : UStateBase::OnStateExited_Implementation() FromState %s,ToState: %s"),
-		*Owner->GetName(),*StateTag.GetTagName().ToString(),*ToState.GetTagName().ToString());
-	
+#if !UE_BUILD_SHIPPING
+	UE_LOG(LogTemp,Verbose,TEXT("[OwnerName: %s] : UStateBase::OnStateExited_Implementation() FromState %s,ToState: %s"),
+		*GetNameSafe(Context.Owner),*StateTag.GetTagName().ToString(),*ToState.GetTagName().ToString());
+#endif
 }
 
-bool UStateBase::ShouldActive_Implementation()
+bool UStateBase::ShouldActive_Implementation(const FStateContext& Context)
 {
 	return true;
 }
 
-void UStateBase::Update(float DeltaTime)
+void UStateBase::PostInitProperties()
+{
+	Super::PostInitProperties();
+	bShouldActiveInScript = GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UStateBase, ShouldActive));
+}
+
+bool UStateBase::CheckShouldActive(const FStateContext& Context)
+{
+	return bShouldActiveInScript ? ShouldActive(Context) : ShouldActive_Implementation(Context);
+}
+
+void UStateBase::Update(const FStateContext& Context, float DeltaTime)
 {
 	
 }
 
-bool UStateBase::CanUpdate() const
+bool UStateBase::CanUpdate(const FStateContext& Context) const
 {
-	return bActive;
-}
\ No newline at end of file
+	return Context.bActive;
+}
+
+void FStateFlowTable::Build(const UStateFlowDataAsset& FlowAsset)
+{
+	*this = FStateFlowTable();
+
+	for (const TSubclassOf<UStateBase>& StateClass : FlowAsset.AllStates)
+	{
+		const UStateBase* DefaultState = StateClass ? StateClass->GetDefaultObject<UStateBase>() : nullptr;
+		if (!DefaultState || !DefaultState->GetStateTag().IsValid() || StateIndices.Contains(DefaultState->GetStateTag()))
+		{
+			continue;
+		}
+		if (StateTags.Num() == MaxStates)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s has more than %d states, the remaining ones are ignored."), *FlowAsset.GetName(), MaxStates);
+			break;
+		}
+
+		StateIndices.Add(DefaultState->GetStateTag(), StateTags.Num());
+		StateTags.Add(DefaultState->GetStateTag());
+		StateClasses.Add(StateClass);
+	}
+
+	// States without a rule may go anywhere
+	const uint64 AllStatesMask = StateTags.Num() == MaxStates ? MAX_uint64 : (uint64(1) << StateTags.Num()) - 1;
+	Transitions.Init(AllStatesMask, StateTags.Num());
+	for (const FStateTransition& Rule : FlowAsset.TransitionRules)
+	{
+		const int32 FromIndex = FindStateIndex(Rule.InitialStateTag);
+		if (FromIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		uint64 Row = 0;
+		for (int32 ToIndex = 0; ToIndex < StateTags.Num(); ++ToIndex)
+		{
+			if (Rule.TransitionStateTags.HasTag(StateTags[ToIndex]))
+			{
+				Row |= uint64(1) << ToIndex;
+			}
+		}
+		Transitions[FromIndex] = Row;
+	}
+
+	InitialStateIndex = FindStateIndex(FlowAsset.InitialStateTag);
+}
+
+const FStateFlowTable& UStateFlowDataAsset::GetFlowTable() const
+{
+	if (!bFlowTableBuilt)
+	{
+		FlowTable.Build(*this);
+		bFlowTableBuilt = true;
+	}
+	return FlowTable;
+}
+
+const TArray<TObjectPtr<UStateBase>>& UStateFlowDataAsset::GetSharedStates()
+{
+	const FStateFlowTable& Table = GetFlowTable();
+	if (SharedStates.Num() != Table.Num())
+	{
+		SharedStates.Reset(Table.Num());
+		for (const TSubclassOf<UStateBase>& StateClass : Table.StateClasses)
+		{
+			SharedStates.Add(NewObject<UStateBase>(this, StateClass, NAME_None, RF_Transient));
+		}
+	}
+	return SharedStates;
+}
+
+#if WITH_EDITOR
+void UStateFlowDataAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	bFlowTableBuilt = false;
+	SharedStates.Reset();
+}
+#endif
@@ -6,6 +6,20 @@
 #include "UObject/Object.h"
 #include "StateBase.generated.h"
 
+/** Per owner data of a state machine. States only read it, so one state object can serve many owners. */
+USTRUCT(BlueprintType)
+struct FStateContext
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Transient, Category = "State Machine")
+	TObjectPtr<UObject> Owner{nullptr};
+
+	/** Between OnStateEntered and OnStateExited of the current state */
+	UPROPERTY(BlueprintReadOnly, Transient, Category = "State Machine")
+	bool bActive{false};
+};
+
 /**
  * 
  */
@@ -21,26 +35,66 @@ public:
 	FGameplayTag StateTag;
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
-	void OnStateEntered(const FGameplayTag& FromState);
+	void OnStateEntered(const FStateContext& Context, const FGameplayTag& FromState);
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
-	void OnStateExited(const FGameplayTag& ToState);
+	void OnStateExited(const FStateContext& Context, const FGameplayTag& ToState);
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
-	bool ShouldActive();
+	bool ShouldActive(const FStateContext& Context);
+
+	/** ShouldActive without the Blueprint thunk when no Blueprint overrides it. */
+	bool CheckShouldActive(const FStateContext& Context);
 
-	virtual void Update(float DeltaTime);
+	virtual void Update(const FStateContext& Context, float DeltaTime);
 	
-	virtual bool CanUpdate() const;
+	virtual bool CanUpdate(const FStateContext& Context) const;
 	
 	UFUNCTION(BlueprintPure, Category = "State Machine")
 	FGameplayTag GetStateTag() const { return StateTag; }
 	
-	UPROPERTY(Transient)
-	TObjectPtr<UObject> Owner;
+	virtual void PostInitProperties() override;
+
+private:
+	bool bShouldActiveInScript {false};
+};
+
+class UStateFlowDataAsset;
+
+/**
+ * Compiled UStateFlowDataAsset, shared by every state machine using the asset.
+ * States are addressed by dense index, allowed transitions are one bit mask per state.
+ */
+struct PORTAL_API FStateFlowTable
+{
+	static constexpr int32 MaxStates = 64;
+
+	void Build(const UStateFlowDataAsset& FlowAsset);
+
+	int32 FindStateIndex(const FGameplayTag& StateTag) const
+	{
+		const int32* StateIndex = StateIndices.Find(StateTag);
+		return StateIndex ? *StateIndex : INDEX_NONE;
+	}
+
+	bool CanTransition(const int32 FromIndex, const int32 ToIndex) const
+	{
+		return (Transitions[FromIndex] >> ToIndex) & 1;
+	}
+
+	int32 Num() const { return StateTags.Num(); }
+
+	TArray<FGameplayTag> StateTags;
+
+	TArray<TSubclassOf<UStateBase>> StateClasses;
+
+	/** Bit N of row M is set when state N may be entered from state M */
+	TArray<uint64> Transitions;
+
+	int32 InitialStateIndex{INDEX_NONE};
 
 private:
-	bool bActive {false};
+	TMap<FGameplayTag, int32> StateIndices;
 };
 
 USTRUCT(BlueprintType)
@@ -71,4 +125,21 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Machine")
 	TArray<TSubclassOf<UStateBase>> AllStates;
+
+	/** Built on first use. */
+	const FStateFlowTable& GetFlowTable() const;
+
+	/** One instance per state, in FStateFlowTable order, for state machines sharing their states. */
+	const TArray<TObjectPtr<UStateBase>>& GetSharedStates();
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	mutable FStateFlowTable FlowTable;
+	mutable bool bFlowTableBuilt{false};
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UStateBase>> SharedStates;
 };
\ No newline at end of file
@@ -3,13 +3,16 @@
 
 #include "StateMachineComponent.h"
 
-#pragma optimize("", off)
+#include "StateTransitionTrace.h"
+
 // Sets default values for this component's properties
 UStateMachineComponent::UStateMachineComponent()
 {
 	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
+	// Enabled by the first state that can update
+	PrimaryComponentTick.bStartWithTickEnabled = false;
 	SetTickGroup(TG_PostUpdateWork);
 	// ...
 }
@@ -25,33 +28,29 @@ void UStateMachineComponent::BeginPlay()
 		return;
 	}
 
-	for (const auto& StateClass: TransitionConfig->AllStates)
+	// 状态索引和切换规则由资产编译一次，所有组件共用
+	FlowTable = &TransitionConfig->GetFlowTable();
+	StateContext.Owner = GetOwner();
+	TransitionTrace = UWorld::GetSubsystem<UStateTransitionTrace>(GetWorld());
+
+	if (bShareStates)
 	{
-		// 实例化所有的State
-		if (StateClass && StateClass->GetDefaultObject<UStateBase>())
-		{
-			FGameplayTag StateTag = StateClass->GetDefaultObject<UStateBase>()->GetStateTag();
-			if (StateTag.IsValid() && !AllStates.Contains(StateTag))
-			{
-				if (UStateBase* NewStateInstance = NewObject<UStateBase>(this, StateClass))
-				{
-					NewStateInstance->Owner = GetOwner();
-					AllStates.Add(StateTag, NewStateInstance);
-				}
-			}
-		}
+		States = TransitionConfig->GetSharedStates();
 	}
-	
-	for (const auto& [InitialStateTag, TransitionStateTags] : TransitionConfig->TransitionRules)
+	else
 	{
-		// 2. 缓存状态切换规则
-		TransitionRules.Add(InitialStateTag, TransitionStateTags);
+		States.Reserve(FlowTable->Num());
+		for (const TSubclassOf<UStateBase>& StateClass : FlowTable->StateClasses)
+		{
+			// 实例化所有的State
+			States.Add(NewObject<UStateBase>(this, StateClass));
+		}
 	}
 	
 	// 3. 切换到初始状态
-	if (TransitionConfig->InitialStateTag.IsValid())
+	if (FlowTable->InitialStateIndex != INDEX_NONE)
 	{
-		TryChangeState(TransitionConfig->InitialStateTag);
+		TryChangeState(FlowTable->StateTags[FlowTable->InitialStateIndex]);
 	}
 }
 
@@ -61,52 +60,61 @@ void UStateMachineComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	if (CurrentState && CurrentState->ShouldActive())
+	if (CurrentState && CurrentState->CheckShouldActive(StateContext))
 	{
-		CurrentState->Update(DeltaTime);
+		CurrentState->Update(StateContext, DeltaTime);
+	}
+}
+
+void UStateMachineComponent::UpdateTickEnabled()
+{
+	const bool bShouldTick = CurrentState && CurrentState->CanUpdate(StateContext);
+	if (IsComponentTickEnabled() != bShouldTick)
+	{
+		SetComponentTickEnabled(bShouldTick);
 	}
 }
 
 bool UStateMachineComponent::TryChangeState(const FGameplayTag NewStateTag)
 {
-	// 检查是否在AllStates Map中存在新状态的实例
-	if (!AllStates.Contains(NewStateTag))
+	// 检查新状态是否存在
+	const int32 NewStateIndex = FlowTable ? FlowTable->FindStateIndex(NewStateTag) : INDEX_NONE;
+	if (NewStateIndex == INDEX_NONE)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("Attempted to change to a non-existent state: %s"), *NewStateTag.ToString());
 		return false;
 	}
 	
-	if (CurrentState)
+	// 检查当前状态是否允许切换到目标状态
+	if (CurrentStateIndex != INDEX_NONE && !FlowTable->CanTransition(CurrentStateIndex, NewStateIndex))
 	{
-		// 查找当前状态的切换规则
-		if (const auto& AllowedTransitions = TransitionRules.Find(CurrentState->GetStateTag()))
-		{
-			// 检查目标状态是否在允许的列表中
-			bool bIsAllowed = AllowedTransitions->HasTag(NewStateTag);
-			if (!bIsAllowed)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Transition from %s to %s is not allowed."), *CurrentState->GetStateTag().ToString(), *NewStateTag.ToString());
-				return false;
-			}
-		}
+		UE_LOG(LogTemp, Warning, TEXT("Transition from %s to %s is not allowed."), *CurrentState->GetStateTag().ToString(), *NewStateTag.ToString());
+		return false;
 	}
     
-	UStateBase* NextState = AllStates[NewStateTag];
-	if (NextState && NextState->ShouldActive())
+	UStateBase* NextState = States[NewStateIndex];
+	if (NextState->CheckShouldActive(StateContext))
 	{
 		// 退出当前状态
 		FGameplayTag PreviousStateTag;
 		if (CurrentState)
 		{
 			PreviousStateTag = CurrentState->GetStateTag();
-			CurrentState->OnStateExited_Implementation(NewStateTag);
+			CurrentState->OnStateExited_Implementation(StateContext, NewStateTag);
+			StateContext.bActive = false;
 		}
         
 		// 进入新状态
 		CurrentState = NextState;
-		CurrentState->OnStateEntered_Implementation(PreviousStateTag);
+		CurrentStateIndex = NewStateIndex;
+		StateContext.bActive = true;
+		CurrentState->OnStateEntered_Implementation(StateContext, PreviousStateTag);
+		if (TransitionTrace)
+		{
+			TransitionTrace->RecordTransition(GetOwner(), PreviousStateTag, NewStateTag);
+		}
+		UpdateTickEnabled();
 	}
 	
 	return true;
 }
-#pragma optimize("", on)
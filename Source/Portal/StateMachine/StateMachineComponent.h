@@ -10,6 +10,7 @@
 
 
 class UStateBase;
+class UStateTransitionTrace;
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class PORTAL_API UStateMachineComponent : public UActorComponent
@@ -33,20 +34,38 @@ public:
 
 	UFUNCTION(BlueprintPure, Category = "State Machine")
 	UStateBase* GetCurrentState(){return CurrentState;}
+
+	const FStateContext& GetStateContext() const { return StateContext; }
+
+	/** Use the flow asset's shared state instances instead of creating a set per component. */
+	UPROPERTY(EditDefaultsOnly, Category = "State Machine|State")
+	bool bShareStates{false};
 	
 protected:
+
+	/** Ticks only while the current state wants updates. */
+	void UpdateTickEnabled();
 	
 	UPROPERTY(Transient)
 	TObjectPtr<UStateBase> CurrentState;
 
-	/** 预先创建的所有状态实例。 */
+	/** 所有状态实例，按FlowTable的状态索引排列。共享模式下由TransitionConfig持有。 */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UStateBase>> States;
+
 	UPROPERTY(Transient)
-	TMap<FGameplayTag, TObjectPtr<UStateBase>> AllStates;
+	FStateContext StateContext;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStateTransitionTrace> TransitionTrace;
 	
 	UPROPERTY(EditDefaultsOnly, Category = "State Machine|State")
 	UStateFlowDataAsset* TransitionConfig;
 
 private:
-	
-	TMap<FGameplayTag, FGameplayTagContainer> TransitionRules;
+
+	/** Owned by TransitionConfig */
+	const FStateFlowTable* FlowTable{nullptr};
+
+	int32 CurrentStateIndex{INDEX_NONE};
 };
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StateTransitionTrace.h"
+
+#include "GameplayTagsManager.h"
+#include "Trace/Trace.inl"
+
+UE_TRACE_CHANNEL(StateMachineChannel)
+
+UE_TRACE_EVENT_BEGIN(StateMachine, Transition)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint64, Frame)
+	UE_TRACE_EVENT_FIELD(uint32, OwnerId)
+	UE_TRACE_EVENT_FIELD(uint16, FromTag)
+	UE_TRACE_EVENT_FIELD(uint16, ToTag)
+UE_TRACE_EVENT_END()
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorldAndArgs GStateMachineDumpTransitionsCommand(
+	TEXT("StateMachine.DumpTransitions"),
+	TEXT("Logs the most recent state machine transitions of the world. Optional argument: number of transitions (default 32)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (const UStateTransitionTrace* TransitionTrace = UWorld::GetSubsystem<UStateTransitionTrace>(World))
+		{
+			TransitionTrace->DumpTransitions(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 32);
+		}
+	}));
+#endif
+
+bool UStateTransitionTrace::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UStateTransitionTrace::RecordTransition(const UObject* Owner, const FGameplayTag& FromState, const FGameplayTag& ToState)
+{
+	const UGameplayTagsManager& TagsManager = UGameplayTagsManager::Get();
+
+	FStateTransitionRecord& Record = Records[NumRecorded % Capacity];
+	Record.OwnerId = Owner ? Owner->GetUniqueID() : 0;
+	Record.FromTag = TagsManager.GetNetIndexFromTag(FromState);
+	Record.ToTag = TagsManager.GetNetIndexFromTag(ToState);
+	Record.Frame = GFrameCounter;
+	Record.Cycles = FPlatformTime::Cycles64();
+	++NumRecorded;
+
+	UE_TRACE_LOG(StateMachine, Transition, StateMachineChannel)
+		<< Transition.Cycle(Record.Cycles)
+		<< Transition.Frame(Record.Frame)
+		<< Transition.OwnerId(Record.OwnerId)
+		<< Transition.FromTag(Record.FromTag)
+		<< Transition.ToTag(Record.ToTag);
+}
+
+void UStateTransitionTrace::DumpTransitions(const int32 Count) const
+{
+	const UGameplayTagsManager& TagsManager = UGameplayTagsManager::Get();
+	const uint64 NowCycles = FPlatformTime::Cycles64();
+
+	const uint32 NumToDump = FMath::Min<uint32>(FMath::Max(Count, 0), FMath::Min<uint32>(NumRecorded, Capacity));
+	UE_LOG(LogTemp, Display, TEXT("%s: last %u of %u state transitions"), *GetWorld()->GetName(), NumToDump, NumRecorded);
+	for (uint32 RecordIndex = NumRecorded - NumToDump; RecordIndex < NumRecorded; ++RecordIndex)
+	{
+		const FStateTransitionRecord& Record = Records[RecordIndex % Capacity];
+		const FUObjectItem* OwnerItem = GUObjectArray.IndexToObject(Record.OwnerId);
+		const UObjectBase* Owner = OwnerItem ? OwnerItem->GetObject() : nullptr;
+		UE_LOG(LogTemp, Display, TEXT("  Frame %llu (%.1f ms ago) %s: %s -> %s"),
+			Record.Frame,
+			FPlatformTime::ToMilliseconds64(NowCycles - Record.Cycles),
+			Owner ? *static_cast<const UObject*>(Owner)->GetName() : TEXT("None"),
+			*TagsManager.GetTagNameFromNetIndex(Record.FromTag).ToString(),
+			*TagsManager.GetTagNameFromNetIndex(Record.ToTag).ToString());
+	}
+}
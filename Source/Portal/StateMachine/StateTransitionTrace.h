@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "StateTransitionTrace.generated.h"
+
+struct FStateTransitionRecord
+{
+	/** UObject unique id of the state machine owner */
+	uint32 OwnerId{0};
+
+	/** FGameplayTagNetIndex of the previous and new state */
+	uint16 FromTag{0};
+	uint16 ToTag{0};
+
+	uint64 Frame{0};
+	uint64 Cycles{0};
+};
+
+/**
+ * Recent state machine transitions of a world, kept in a fixed ring buffer and sent to
+ * Unreal Insights on the StateMachine trace channel. Dump with "StateMachine.DumpTransitions [Count]".
+ */
+UCLASS()
+class PORTAL_API UStateTransitionTrace : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	static constexpr int32 Capacity = 256;
+
+	void RecordTransition(const UObject* Owner, const FGameplayTag& FromState, const FGameplayTag& ToState);
+
+	/** Logs the newest Count transitions, oldest first. */
+	void DumpTransitions(int32 Count) const;
+
+protected:
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+
+	TStaticArray<FStateTransitionRecord, Capacity> Records;
+
+	/** Transitions recorded so far, the next one goes to NumRecorded % Capacity */
+	uint32 NumRecorded{0};
+};